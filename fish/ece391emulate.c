@@ -176,6 +176,63 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+int32_t 
+ece391_mmap (int32_t fd, uint8_t** start)
+{
+    /* not emulated; callers fall back to ece391_read */
+    return -1;
+}
+
+int32_t 
+ece391_getdents (int32_t fd, void* buf, int32_t nbytes)
+{
+    /* not emulated; callers fall back to ece391_read */
+    return -1;
+}
+
+int32_t 
+ece391_stat (const uint8_t* filename, ece391_stat_t* buf)
+{
+    /* not emulated */
+    return -1;
+}
+
+int32_t 
+ece391_fstat (int32_t fd, ece391_stat_t* buf)
+{
+    /* not emulated */
+    return -1;
+}
+
+int32_t 
+ece391_lseek (int32_t fd, int32_t offset, int32_t whence)
+{
+    return lseek (fd, offset, whence);
+}
+
+int32_t 
+ece391_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset)
+{
+    return pread (fd, buf, nbytes, offset);
+}
+
+int32_t 
+ece391_nice (int32_t increment)
+{
+    return nice (increment);
+}
+
+int32_t 
+ece391_sched_periodic (int32_t period_ms, int32_t budget_ms)
+{
+    /* the host schedules us as it likes, only the arguments are checked */
+    if (period_ms < 0 || budget_ms < 0)
+        return -1;
+    if (period_ms != 0 && (budget_ms == 0 || budget_ms > period_ms))
+        return -1;
+    return 0;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
@@ -3,6 +3,22 @@
 
 #include <stdint.h>
 
+/* One directory entry returned by ece391_getdents */
+typedef struct ece391_dirent {
+    uint32_t inode;
+    uint32_t size;      /* in bytes, 0 for anything but a regular file */
+    int32_t type;       /* 0 rtc, 1 directory, 2 regular file */
+    uint8_t name[32];   /* NUL padded, not terminated if 32 chars long */
+} ece391_dirent_t;
+
+/* File information returned by ece391_stat and ece391_fstat */
+typedef struct ece391_stat {
+    uint32_t inode;
+    uint32_t size;      /* in bytes, 0 for anything but a regular file */
+    int32_t type;       /* 0 rtc, 1 directory, 2 regular file */
+    uint32_t blocks;    /* 4kB data blocks holding the file */
+} ece391_stat_t;
+
 /* All calls return >= 0 on success or -1 on failure. */
 
 /*  
@@ -19,6 +35,21 @@ extern int32_t ece391_open (const uint8_t* filename);
 extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
+/* Maps an open file read-only; returns its length and sets *start */
+extern int32_t ece391_mmap (int32_t fd, uint8_t** start);
+/* Fills buf with ece391_dirent_t records; returns bytes filled, 0 at end */
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+/* Fill buf with the size and type of a file, by name or open fd */
+extern int32_t ece391_stat (const uint8_t* filename, ece391_stat_t* buf);
+extern int32_t ece391_fstat (int32_t fd, ece391_stat_t* buf);
+/* Move the position of an open file; whence is 0 start, 1 current, 2 end */
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+/* Read an open file at offset without moving its position */
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset);
+/* Add to the caller's nice value, higher runs behind other work; returns the new value */
+extern int32_t ece391_nice (int32_t increment);
+/* Reserve budget_ms of CPU every period_ms ahead of other work, period 0 gives it back; 0 on success */
+extern int32_t ece391_sched_periodic (int32_t period_ms, int32_t budget_ms);
 
 #endif /* ECE391SYSCALL_H */
 
@@ -0,0 +1,742 @@
+/*
+ * mkfs - builds the filesystem image loaded as the kernel's multiboot module
+ *
+ * Usage: mkfs [-2] [-z] [-t] -i <directory> -o <image>
+ *   -2  write the v2 format (extent inodes, more than 63 files, files over 4MB)
+ *   -z  LZ4 compress regular files that aren't executables when it saves blocks
+ *   -t  add a trigram index of every file's contents, the file ".tri", for grep
+ *
+ * Every regular file in the directory becomes a dentry, after "." and "rtc".
+ * A file's data blocks are laid out back to back. A 4KB block identical to one
+ * already written is shared instead of written again, when the shared run is
+ * DEDUP_MIN_RUN blocks long or is the whole file, so sharing rarely splits a
+ * file into more than one extent. A layout report is printed at the end.
+ *
+ * The trigram index is little endian: a 16B header {magic "TRI1", numFiles,
+ * numTrigrams, 0}, then numFiles {inode, length} pairs ordered by inode, then
+ * numTrigrams + 1 {trigram, firstPosting} pairs ordered by trigram (the last
+ * only ends the previous list), then 16 bit postings. A trigram's postings
+ * are the indexes into the file table of the files that contain it.
+ *
+ * The on-disk structures mirror student-distrib/filesys.h, which can't be
+ * included here since it pulls in the kernel's own types and libc.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOCK_SIZE              4096
+#define DENTRY_SIZE             64
+#define MAX_DENTRIES            63
+#define MAX_DATA_BLOCKS         1023
+#define MAX_FILE_NAME_LEN       32
+#define BOOT_BLOCK_HEADER       64   // v1 boot block bytes before the first dentry
+#define FS_V2_MAGIC             0x32465346
+#define FS_VERSION_2            2
+#define DENTRIES_PER_BLOCK      (BLOCK_SIZE / DENTRY_SIZE)
+#define MAX_DENTRIES_V2         1024
+#define V2_INODE_EXTENTS        340
+#define ZINODE_MAX_CHUNKS       512
+#define ZINODE_MAX_STREAM_BLOCKS 508
+#define TYPE_RTC                0    // dentry file types, RTC, DIR, FILE and TYPE_COMPRESSED in filesys.h
+#define TYPE_DIR                1
+#define TYPE_FILE               2
+#define TYPE_COMPRESSED         3
+
+#define HASH_SIZE               65536 // buckets of the block dedup table, power of 2
+#define DEDUP_MIN_RUN           4     // shortest shared run that may split a file
+#define TRI_NAME                ".tri"
+#define TRI_MAGIC               0x31495254 // "TRI1"
+#define TRI_HEADER_SIZE         16
+#define LZ4_HASH_BITS           12
+#define LZ4_MIN_MATCH           4
+#define LZ4_LAST_LITERALS       5     // the last sequence ends with at least this many literals
+#define LZ4_MATCH_LIMIT         12    // no match starts in the last 12 bytes of a block
+
+typedef struct file_t {
+    char name[MAX_FILE_NAME_LEN + 1];
+    uint8_t* data;
+    uint32_t length;
+    int32_t type;             // TYPE_FILE or TYPE_COMPRESSED
+    uint32_t inodeNum;
+    uint32_t numBlocks;       // data blocks holding the file, or its compressed stream
+    uint32_t* blockMap;       // data block number of each of those blocks
+    uint32_t numExtents;
+    uint32_t shared;          // blocks reused from earlier files
+    uint32_t numChunks;       // TYPE_COMPRESSED only
+    uint32_t* chunkOffsets;   // numChunks + 1 offsets into the stream
+} file_t;
+
+static file_t* files;
+static uint32_t num_files;
+static int v2;
+static int compress;
+static int trigrams;
+
+static uint8_t* blocks;        // the data block area of the image
+static uint32_t num_blocks;
+static uint32_t cap_blocks;
+static uint32_t* hash_head;    // block number + 1 of the newest block in each bucket
+static uint32_t* hash_next;    // block number + 1 of the next block in the same bucket
+
+/**
+ * die
+ *
+ * Description: Prints an error and exits
+ * Inputs: msg - message, name - file it is about, may be NULL
+ * Outputs: none
+ * Side Effects: Exits with status 1
+ */
+static void die(const char* msg, const char* name) {
+    if (name)
+        fprintf(stderr, "mkfs: %s: %s\n", name, msg);
+    else
+        fprintf(stderr, "mkfs: %s\n", msg);
+    exit(1);
+}
+
+/**
+ * xmalloc
+ *
+ * Description: malloc that zeroes and exits when out of memory
+ * Inputs: size - bytes to allocate
+ * Outputs: Pointer to the zeroed memory
+ * Side Effects: none
+ */
+static void* xmalloc(size_t size) {
+    void* p = calloc(1, size ? size : 1);
+    if (p == NULL)
+        die("out of memory", NULL);
+    return p;
+}
+
+/**
+ * compare_files
+ *
+ * Description: qsort comparator, orders files by name
+ */
+static int compare_files(const void* a, const void* b) {
+    return strcmp(((const file_t*)a)->name, ((const file_t*)b)->name);
+}
+
+/**
+ * compare_u32
+ *
+ * Description: qsort comparator for 32 bit keys
+ */
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * load_files
+ *
+ * Description: Reads every regular file in a directory into files, sorted by name
+ * Inputs: dir - directory to read
+ * Outputs: none
+ * Side Effects: Fills files and num_files, exits on an error
+ */
+static void load_files(const char* dir) {
+    DIR* d;
+    struct dirent* ent;
+    struct stat st;
+    char path[4096];
+    FILE* fp;
+    uint32_t cap = 64, i;
+
+    if ((d = opendir(dir)) == NULL)
+        die(strerror(errno), dir);
+    files = xmalloc(cap * sizeof(file_t));
+
+    while ((ent = readdir(d)) != NULL) {
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) || !S_ISREG(st.st_mode))
+            continue;
+        if (!strcmp(ent->d_name, "rtc"))
+            die("name is taken by the rtc device", path);
+        if (trigrams && !strcmp(ent->d_name, TRI_NAME))
+            die("name is taken by the trigram index", path);
+        if (num_files == cap) {
+            cap *= 2;
+            if ((files = realloc(files, cap * sizeof(file_t))) == NULL)
+                die("out of memory", NULL);
+        }
+
+        file_t* f = &files[num_files++];
+        memset(f, 0, sizeof(*f));
+        // names longer than a dentry holds are cut, like the kernel compares them
+        memcpy(f->name, ent->d_name, strnlen(ent->d_name, MAX_FILE_NAME_LEN));
+        f->type = TYPE_FILE;
+        f->length = st.st_size;
+        if ((uint64_t)st.st_size != f->length)
+            die("file is over 4GB", path);
+        f->data = xmalloc(f->length);
+        if ((fp = fopen(path, "rb")) == NULL || fread(f->data, 1, f->length, fp) != f->length)
+            die("can't read file", path);
+        fclose(fp);
+    }
+    closedir(d);
+
+    // the index's contents are built once every file has its inode number
+    if (trigrams) {
+        if ((files = realloc(files, (num_files + 1) * sizeof(file_t))) == NULL)
+            die("out of memory", NULL);
+        memset(&files[num_files], 0, sizeof(file_t));
+        strcpy(files[num_files].name, TRI_NAME);
+        files[num_files++].type = TYPE_FILE;
+    }
+
+    qsort(files, num_files, sizeof(file_t), compare_files);
+    for (i = 1; i < num_files; i++) {
+        if (!strcmp(files[i - 1].name, files[i].name))
+            die("two files have the same first 32 characters", files[i].name);
+    }
+    if (num_files + 2 > (v2 ? MAX_DENTRIES_V2 : MAX_DENTRIES))
+        die(v2 ? "too many files" : "too many files for v1, use -2", dir);
+}
+
+/**
+ * block_hash
+ *
+ * Description: FNV-1a hash of a data block
+ * Inputs: data - BLOCK_SIZE bytes
+ * Outputs: Bucket in the dedup table
+ */
+static uint32_t block_hash(const uint8_t* data) {
+    uint32_t h = 2166136261u, i;
+    for (i = 0; i < BLOCK_SIZE; i++)
+        h = (h ^ data[i]) * 16777619u;
+    return h & (HASH_SIZE - 1);
+}
+
+/**
+ * get_file_block
+ *
+ * Description: Copies one block of a buffer, zero padding past its end
+ * Inputs: data, length - the buffer, idx - block index, out - BLOCK_SIZE buffer
+ * Outputs: none
+ */
+static void get_file_block(const uint8_t* data, uint32_t length, uint32_t idx, uint8_t* out) {
+    uint32_t n = length - idx * BLOCK_SIZE;
+    if (n > BLOCK_SIZE) n = BLOCK_SIZE;
+    memset(out, 0, BLOCK_SIZE);
+    memcpy(out, data + idx * BLOCK_SIZE, n);
+}
+
+/**
+ * append_block
+ *
+ * Description: Writes a new data block at the end of the data area
+ * Inputs: data - BLOCK_SIZE bytes
+ * Outputs: Its data block number
+ * Side Effects: Grows blocks and adds the block to the dedup table
+ */
+static uint32_t append_block(const uint8_t* data) {
+    uint32_t h = block_hash(data);
+
+    if (num_blocks == cap_blocks) {
+        cap_blocks = cap_blocks ? cap_blocks * 2 : 256;
+        if ((blocks = realloc(blocks, (size_t)cap_blocks * BLOCK_SIZE)) == NULL ||
+            (hash_next = realloc(hash_next, cap_blocks * sizeof(uint32_t))) == NULL)
+            die("out of memory", NULL);
+    }
+    memcpy(blocks + (size_t)num_blocks * BLOCK_SIZE, data, BLOCK_SIZE);
+    hash_next[num_blocks] = hash_head[h];
+    hash_head[h] = num_blocks + 1;
+    return num_blocks++;
+}
+
+/**
+ * find_shared_run
+ *
+ * Description: Finds the longest run of written blocks equal to a file's blocks from idx on
+ * Inputs: f - file, idx - first file block, start - filled with the run's first data block
+ * Outputs: Length of the run, 0 if block idx was never written
+ */
+static uint32_t find_shared_run(const file_t* f, uint32_t idx, uint32_t* start) {
+    uint8_t want[BLOCK_SIZE];
+    uint32_t best = 0, len, cand;
+
+    get_file_block(f->data, f->length, idx, want);
+    for (cand = hash_head[block_hash(want)]; cand; cand = hash_next[cand - 1]) {
+        if (memcmp(blocks + (size_t)(cand - 1) * BLOCK_SIZE, want, BLOCK_SIZE))
+            continue;
+        for (len = 1; idx + len < f->numBlocks && cand - 1 + len < num_blocks; len++) {
+            get_file_block(f->data, f->length, idx + len, want);
+            if (memcmp(blocks + (size_t)(cand - 1 + len) * BLOCK_SIZE, want, BLOCK_SIZE))
+                break;
+        }
+        get_file_block(f->data, f->length, idx, want);
+        if (len > best) {
+            best = len;
+            *start = cand - 1;
+        }
+    }
+    return best;
+}
+
+/**
+ * count_extents
+ *
+ * Description: Counts the runs of consecutive data blocks in a block map
+ * Inputs: map - data block of each file block, n - blocks in the map
+ * Outputs: Number of extents
+ */
+static uint32_t count_extents(const uint32_t* map, uint32_t n) {
+    uint32_t i, count = n ? 1 : 0;
+    for (i = 1; i < n; i++) {
+        if (map[i] != map[i - 1] + 1)
+            count++;
+    }
+    return count;
+}
+
+/**
+ * place_file
+ *
+ * Description: Chooses the data blocks of a regular file. New blocks are appended back to
+ *              back, an already written run is shared when that doesn't cost contiguity
+ * Inputs: f - file
+ * Outputs: none
+ * Side Effects: Appends blocks, fills the file's block map, extents and shared count
+ */
+static void place_file(file_t* f) {
+    uint8_t buf[BLOCK_SIZE];
+    uint32_t idx, run, start = 0, k, first_new = num_blocks;
+
+    f->numBlocks = (f->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (!v2 && f->numBlocks > MAX_DATA_BLOCKS)
+        die("file is over 4MB, use -2", f->name);
+    f->blockMap = xmalloc(f->numBlocks * sizeof(uint32_t));
+
+    for (idx = 0; idx < f->numBlocks; idx += run) {
+        run = find_shared_run(f, idx, &start);
+        // a run found among this file's own new blocks would only repeat them
+        if (run && start >= first_new)
+            run = 0;
+        if (run && (run >= DEDUP_MIN_RUN || (idx == 0 && run == f->numBlocks))) {
+            for (k = 0; k < run; k++)
+                f->blockMap[idx + k] = start + k;
+            f->shared += run;
+            continue;
+        }
+        run = 1;
+        get_file_block(f->data, f->length, idx, buf);
+        f->blockMap[idx] = append_block(buf);
+    }
+    f->numExtents = count_extents(f->blockMap, f->numBlocks);
+
+    // sharing split the file into more extents than a v2 inode holds, so write it whole
+    if (f->numExtents > V2_INODE_EXTENTS) {
+        for (idx = 0; idx < f->numBlocks; idx++) {
+            get_file_block(f->data, f->length, idx, buf);
+            f->blockMap[idx] = append_block(buf);
+        }
+        f->shared = 0;
+        f->numExtents = 1;
+    }
+}
+
+/**
+ * lz4_put_length
+ *
+ * Description: Writes the extra bytes of a literal or match length of 15 or more
+ * Inputs: dst - output, pos - write position, len - length minus 15
+ * Outputs: New write position
+ */
+static uint32_t lz4_put_length(uint8_t* dst, uint32_t pos, uint32_t len) {
+    for (; len >= 255; len -= 255)
+        dst[pos++] = 255;
+    dst[pos++] = len;
+    return pos;
+}
+
+/**
+ * lz4_compress
+ *
+ * Description: Greedy LZ4 block compressor, the format filesys.c decodes
+ * Inputs: src, len - chunk to compress, dst - at least len + len / 255 + 16 bytes
+ * Outputs: Compressed length
+ */
+static uint32_t lz4_compress(const uint8_t* src, uint32_t len, uint8_t* dst) {
+    uint32_t table[1 << LZ4_HASH_BITS];
+    uint32_t pos = 0, anchor = 0, out = 0, cand, match, lit, h, v;
+
+    memset(table, 0xFF, sizeof(table));
+    while (len >= LZ4_MATCH_LIMIT && pos + LZ4_MATCH_LIMIT <= len) {
+        memcpy(&v, src + pos, 4);
+        h = (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        cand = table[h];
+        table[h] = pos;
+        if (cand == 0xFFFFFFFF || pos - cand > 0xFFFF || memcmp(src + cand, src + pos, LZ4_MIN_MATCH)) {
+            pos++;
+            continue;
+        }
+
+        for (match = LZ4_MIN_MATCH; pos + match < len - LZ4_LAST_LITERALS && src[cand + match] == src[pos + match]; match++);
+        lit = pos - anchor;
+        dst[out++] = ((lit < 15 ? lit : 15) << 4) | (match - LZ4_MIN_MATCH < 15 ? match - LZ4_MIN_MATCH : 15);
+        if (lit >= 15)
+            out = lz4_put_length(dst, out, lit - 15);
+        memcpy(dst + out, src + anchor, lit);
+        out += lit;
+        dst[out++] = (pos - cand) & 0xFF;
+        dst[out++] = (pos - cand) >> 8;
+        if (match - LZ4_MIN_MATCH >= 15)
+            out = lz4_put_length(dst, out, match - LZ4_MIN_MATCH - 15);
+        pos += match;
+        anchor = pos;
+    }
+
+    // the rest goes out as the literals of the last sequence
+    lit = len - anchor;
+    dst[out++] = (lit < 15 ? lit : 15) << 4;
+    if (lit >= 15)
+        out = lz4_put_length(dst, out, lit - 15);
+    memcpy(dst + out, src + anchor, lit);
+    return out + lit;
+}
+
+/**
+ * compress_file
+ *
+ * Description: Stores a file as LZ4 chunks when it is not an executable and that saves blocks
+ * Inputs: f - file
+ * Outputs: 0 if the file was stored compressed, -1 to store it as a regular file
+ * Side Effects: Appends the stream blocks and fills the file's chunk and block lists
+ */
+static int compress_file(file_t* f) {
+    uint8_t zbuf[BLOCK_SIZE + BLOCK_SIZE / 255 + 16], block[BLOCK_SIZE];
+    uint8_t* stream;
+    uint32_t chunk, n, z, streamLen = 0, i;
+
+    // executables are mapped and shared straight out of their data blocks
+    if (f->length >= 4 && !memcmp(f->data, "\177ELF", 4))
+        return -1;
+    f->numChunks = (f->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (f->numChunks == 0 || f->numChunks > ZINODE_MAX_CHUNKS)
+        return -1;
+
+    stream = xmalloc((size_t)f->numChunks * BLOCK_SIZE);
+    f->chunkOffsets = xmalloc((f->numChunks + 1) * sizeof(uint32_t));
+    for (chunk = 0; chunk < f->numChunks; chunk++) {
+        n = f->length - chunk * BLOCK_SIZE;
+        if (n > BLOCK_SIZE) n = BLOCK_SIZE;
+        z = lz4_compress(f->data + chunk * BLOCK_SIZE, n, zbuf);
+        if (z >= BLOCK_SIZE) {
+            // doesn't shrink, stored raw as a full block
+            get_file_block(f->data, f->length, chunk, stream + streamLen);
+            z = BLOCK_SIZE;
+        } else {
+            memcpy(stream + streamLen, zbuf, z);
+        }
+        f->chunkOffsets[chunk] = streamLen;
+        streamLen += z;
+    }
+    f->chunkOffsets[f->numChunks] = streamLen;
+
+    f->numBlocks = (streamLen + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (f->numBlocks >= f->numChunks || f->numBlocks > ZINODE_MAX_STREAM_BLOCKS) {
+        free(stream);
+        free(f->chunkOffsets);
+        f->chunkOffsets = NULL;
+        return -1;
+    }
+
+    f->type = TYPE_COMPRESSED;
+    f->blockMap = xmalloc(f->numBlocks * sizeof(uint32_t));
+    for (i = 0; i < f->numBlocks; i++) {
+        get_file_block(stream, streamLen, i, block);
+        f->blockMap[i] = append_block(block);
+    }
+    f->numExtents = count_extents(f->blockMap, f->numBlocks);
+    free(stream);
+    return 0;
+}
+
+/**
+ * put32
+ *
+ * Description: Stores a little endian 32 bit value
+ */
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/**
+ * compare_u64
+ *
+ * Description: qsort comparator for 64 bit keys
+ */
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * build_trigram_index
+ *
+ * Description: Builds the contents of the trigram index file from every other file, whose
+ *              inode numbers must already be assigned
+ * Inputs: tri - the index file, its data and length are filled
+ * Outputs: none
+ * Side Effects: Exits when an index entry would overflow
+ */
+static void build_trigram_index(file_t* tri) {
+    uint64_t* pairs = NULL;
+    uint32_t* grams;
+    size_t num_pairs = 0, cap_pairs = 0, k, n;
+    uint32_t i, j, num_grams, file_idx = 0, num_tri = 0, last;
+    uint8_t *p, *table, *postings;
+
+    // (trigram << 32 | index in the file table) once per distinct trigram of each file
+    for (i = 0; i < num_files; i++) {
+        const file_t* f = &files[i];
+        if (f == tri)
+            continue;
+        num_grams = f->length >= 3 ? f->length - 2 : 0;
+        grams = xmalloc(num_grams * sizeof(uint32_t));
+        for (j = 0; j < num_grams; j++)
+            grams[j] = f->data[j] << 16 | f->data[j + 1] << 8 | f->data[j + 2];
+        qsort(grams, num_grams, sizeof(uint32_t), compare_u32);
+        for (j = 0; j < num_grams; j++) {
+            if (j > 0 && grams[j] == grams[j - 1])
+                continue;
+            if (num_pairs == cap_pairs) {
+                cap_pairs = cap_pairs ? cap_pairs * 2 : 4096;
+                if ((pairs = realloc(pairs, cap_pairs * sizeof(uint64_t))) == NULL)
+                    die("out of memory", NULL);
+            }
+            pairs[num_pairs++] = (uint64_t)grams[j] << 32 | file_idx;
+        }
+        free(grams);
+        file_idx++;
+    }
+    qsort(pairs, num_pairs, sizeof(uint64_t), compare_u64);
+    for (k = 0; k < num_pairs; k++) {
+        if (k == 0 || pairs[k] >> 32 != pairs[k - 1] >> 32)
+            num_tri++;
+    }
+
+    n = TRI_HEADER_SIZE + 8 * (size_t)file_idx + 8 * ((size_t)num_tri + 1) + 2 * num_pairs;
+    if (n >> 32)
+        die("trigram index is over 4GB", NULL);
+    tri->length = n;
+    tri->data = p = xmalloc(n);
+    put32(p, TRI_MAGIC);
+    put32(p + 4, file_idx);
+    put32(p + 8, num_tri);
+    p += TRI_HEADER_SIZE;
+    for (i = 0; i < num_files; i++) {
+        if (&files[i] == tri)
+            continue;
+        put32(p, files[i].inodeNum);
+        put32(p + 4, files[i].length);
+        p += 8;
+    }
+
+    table = p;
+    postings = table + 8 * ((size_t)num_tri + 1);
+    for (k = 0, last = 0; k < num_pairs; k++) {
+        if (k == 0 || pairs[k] >> 32 != last) {
+            last = pairs[k] >> 32;
+            put32(table, last);
+            put32(table + 4, k);
+            table += 8;
+        }
+        postings[2*k] = pairs[k];
+        postings[2*k + 1] = pairs[k] >> 8;
+    }
+    put32(table, 0);
+    put32(table + 4, num_pairs);
+    free(pairs);
+}
+
+/**
+ * put_dentry
+ *
+ * Description: Fills a 64B dentry
+ */
+static void put_dentry(uint8_t* p, const char* name, uint32_t type, uint32_t inode) {
+    memset(p, 0, DENTRY_SIZE);
+    memcpy(p, name, strnlen(name, MAX_FILE_NAME_LEN));
+    put32(p + MAX_FILE_NAME_LEN, type);
+    put32(p + MAX_FILE_NAME_LEN + 4, inode);
+}
+
+/**
+ * put_inode
+ *
+ * Description: Fills the 4KB inode of a file in the chosen format
+ * Inputs: p - zeroed BLOCK_SIZE buffer, f - file
+ * Outputs: none
+ */
+static void put_inode(uint8_t* p, const file_t* f) {
+    uint32_t i, j, ext = 0;
+
+    if (f->type == TYPE_COMPRESSED) {
+        put32(p, f->length);
+        put32(p + 4, f->numChunks);
+        put32(p + 8, f->numBlocks);
+        for (i = 0; i <= f->numChunks; i++)
+            put32(p + 12 + 4*i, f->chunkOffsets[i]);
+        for (i = 0; i < f->numBlocks; i++)
+            put32(p + 12 + 4*(ZINODE_MAX_CHUNKS + 1) + 4*i, f->blockMap[i]);
+    } else if (!v2) {
+        put32(p, f->length);
+        for (i = 0; i < f->numBlocks; i++)
+            put32(p + 4 + 4*i, f->blockMap[i]);
+    } else {
+        put32(p, f->length);
+        put32(p + 8, f->numExtents);
+        for (i = 0; i < f->numBlocks; i = j) {
+            for (j = i + 1; j < f->numBlocks && f->blockMap[j] == f->blockMap[j - 1] + 1; j++);
+            put32(p + 16 + 12*ext, i);
+            put32(p + 16 + 12*ext + 4, j - i);
+            put32(p + 16 + 12*ext + 8, f->blockMap[i]);
+            ext++;
+        }
+    }
+}
+
+/**
+ * write_image
+ *
+ * Description: Writes the boot block, directory, inodes and data blocks
+ * Inputs: path - image file
+ * Outputs: Size of the image in bytes
+ * Side Effects: Creates or replaces the image file
+ */
+static uint64_t write_image(const char* path) {
+    uint32_t num_dentries = num_files + 2, dir_blocks = 0, i;
+    uint8_t* meta;
+    uint32_t meta_blocks;
+    FILE* fp;
+
+    // boot block (and v2 directory) then inode 0, kept blank for "." and "rtc", then file inodes
+    if (v2)
+        dir_blocks = (num_dentries + DENTRIES_PER_BLOCK - 1) / DENTRIES_PER_BLOCK;
+    meta_blocks = 1 + dir_blocks + 1 + num_files;
+    meta = xmalloc((size_t)meta_blocks * BLOCK_SIZE);
+
+    if (v2) {
+        put32(meta, FS_V2_MAGIC);
+        put32(meta + 4, FS_VERSION_2);
+        put32(meta + 8, num_dentries);
+        put32(meta + 12, num_files + 1);
+        put32(meta + 16, num_blocks);
+        put32(meta + 20, dir_blocks);
+    } else {
+        put32(meta, num_dentries);
+        put32(meta + 4, num_files + 1);
+        put32(meta + 8, num_blocks);
+    }
+
+    uint8_t* dir = meta + (v2 ? BLOCK_SIZE : BOOT_BLOCK_HEADER);
+    put_dentry(dir, ".", TYPE_DIR, 0);
+    put_dentry(dir + DENTRY_SIZE, "rtc", TYPE_RTC, 0);
+    for (i = 0; i < num_files; i++) {
+        put_dentry(dir + (i + 2) * DENTRY_SIZE, files[i].name, files[i].type, files[i].inodeNum);
+        put_inode(meta + (size_t)(1 + dir_blocks + files[i].inodeNum) * BLOCK_SIZE, &files[i]);
+    }
+
+    if ((fp = fopen(path, "wb")) == NULL)
+        die(strerror(errno), path);
+    if (fwrite(meta, BLOCK_SIZE, meta_blocks, fp) != meta_blocks ||
+        (num_blocks && fwrite(blocks, BLOCK_SIZE, num_blocks, fp) != num_blocks) || fclose(fp))
+        die("write failed", path);
+    free(meta);
+    return (uint64_t)(meta_blocks + num_blocks) * BLOCK_SIZE;
+}
+
+/**
+ * print_report
+ *
+ * Description: Prints where each file landed and what sharing and compression saved
+ * Inputs: image_size - bytes written
+ * Outputs: none
+ */
+static void print_report(uint64_t image_size, const file_t* tri) {
+    uint32_t i, plain = 0, fragmented = 0, shared = 0, extents = 0, zfiles = 0, zblocks = 0, zchunks = 0;
+
+    printf("%-32s %10s %7s %7s %6s\n", "name", "size", "blocks", "extents", "shared");
+    for (i = 0; i < num_files; i++) {
+        const file_t* f = &files[i];
+        printf("%-32s %10u %7u %7u %6u%s\n", f->name, f->length, f->numBlocks, f->numExtents, f->shared,
+               f->type == TYPE_COMPRESSED ? "  lz4" : "");
+        if (f->type == TYPE_COMPRESSED) {
+            zfiles++;
+            zblocks += f->numBlocks;
+            zchunks += f->numChunks;
+            continue;
+        }
+        if (f->numBlocks) plain++;
+        if (f->numExtents > 1) fragmented++;
+        shared += f->shared;
+        extents += f->numExtents;
+    }
+
+    printf("\n%s image, %u files, %u data blocks, %llu bytes\n", v2 ? "v2" : "v1", num_files, num_blocks,
+           (unsigned long long)image_size);
+    printf("fragmentation: %u of %u files in more than one extent, %.2f extents per file\n",
+           fragmented, plain, plain ? (double)extents / plain : 0.0);
+    printf("dedup: %u blocks shared, %u bytes saved\n", shared, shared * BLOCK_SIZE);
+    if (compress)
+        printf("lz4: %u files in %u blocks instead of %u, %u bytes saved\n", zfiles, zblocks, zchunks,
+               (zchunks - zblocks) * BLOCK_SIZE);
+    if (tri)
+        printf("trigram index: %u trigrams, %u bytes\n", tri->data[8] | tri->data[9] << 8 | tri->data[10] << 16 |
+               tri->data[11] << 24, tri->length);
+}
+
+int main(int argc, char** argv) {
+    const char* in = NULL;
+    const char* out = NULL;
+    file_t* tri = NULL;
+    uint32_t i;
+    int c;
+
+    while ((c = getopt(argc, argv, "2zti:o:")) != -1) {
+        switch (c) {
+        case '2': v2 = 1; break;
+        case 'z': compress = 1; break;
+        case 't': trigrams = 1; break;
+        case 'i': in = optarg; break;
+        case 'o': out = optarg; break;
+        default: in = NULL; out = NULL; optind = argc; break;
+        }
+    }
+    if (in == NULL || out == NULL || optind != argc) {
+        fprintf(stderr, "usage: %s [-2] [-z] [-t] -i <directory> -o <image>\n", argv[0]);
+        return 1;
+    }
+
+    load_files(in);
+    hash_head = xmalloc(HASH_SIZE * sizeof(uint32_t));
+    for (i = 0; i < num_files; i++) {
+        files[i].inodeNum = i + 1;
+        if (trigrams && !strcmp(files[i].name, TRI_NAME))
+            tri = &files[i];
+    }
+    if (tri)
+        build_trigram_index(tri);
+
+    for (i = 0; i < num_files; i++) {
+        // grep maps the index, which a compressed file can't be
+        if (!compress || &files[i] == tri || compress_file(&files[i]))
+            place_file(&files[i]);
+    }
+
+    print_report(write_image(out), tri);
+    return 0;
+}
@@ -1,4 +1,8 @@
 #include "Terminal.h"
+#include "scheduler.h"
+
+// readers of each terminal waiting for enter on a displayed terminal
+static wait_queue_t read_queues[NUM_TERMINALS];
 
 /** 
  * terminal_open
@@ -26,17 +30,17 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes){
         return -1;
     if (nbytes < 1)                         // if 0 or less bytes, return 
         return 0;
-    sti();                                  // enable interrupts for user keyboard inputs
-
     terminal_t* terminal = (terminal_t *)terminal_data[getDisplayTerm()];
     if (nbytes > 128) // 128 byte max keyboard buffer
         nbytes = 128;
     char * temp_buf = (char *) buf;
     uint32_t bytes_read = 0;
 
-    while (!(((terminal_t *)terminal_data[getExecuteTerm()])->_enter_flag) || getDisplayTerm() != getExecuteTerm());
-
+    // sleep until the keyboard or a terminal switch wakes us, interrupts stay off between
+    // the check and the sleep so a wakeup can't be missed
     cli();
+    while (!(((terminal_t *)terminal_data[getExecuteTerm()])->_enter_flag) || getDisplayTerm() != getExecuteTerm())
+        sleep_on(&read_queues[getExecuteTerm()]);
     int i;
     for (i = 0; i < nbytes; i++) {
         temp_buf[i] = keyboard_buf[i];      // copy keyboard buffer into terminal buffer
@@ -103,3 +107,14 @@ int32_t terminal_close(int32_t fd){
     reset_cursor();
     return -1;
 }
+
+/** 
+ * terminal_wake_readers
+ * Description: Wakes the readers of a terminal, after enter or once it is displayed
+ * Inputs: terminal - terminal number
+ * Outputs: none
+ * Side Effects: Moves its sleeping readers to the run queue, call with interrupts off
+ */
+void terminal_wake_readers(int32_t terminal) {
+    wake_up(&read_queues[terminal]);
+}
@@ -33,5 +33,8 @@ extern int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 // clears screen and resets cursor
 extern int32_t terminal_close(int32_t fd);
 
+// wakes the readers of a terminal
+extern void terminal_wake_readers(int32_t terminal);
+
 
 #endif 
@@ -0,0 +1,362 @@
+#include "ata.h"
+
+/* Primary IDE channel, the boot disk is its master and the filesystem disk its slave */
+#define ATA_DATA            0x1F0
+#define ATA_ERROR           0x1F1
+#define ATA_SECTOR_COUNT    0x1F2
+#define ATA_LBA_LOW         0x1F3
+#define ATA_LBA_MID         0x1F4
+#define ATA_LBA_HIGH        0x1F5
+#define ATA_DRIVE           0x1F6
+#define ATA_COMMAND         0x1F7   // status when read
+#define ATA_CONTROL         0x3F6   // alternate status when read
+#define ATA_DRIVE_SLAVE_LBA 0xF0    // LBA addressing, slave drive, top 4 LBA bits below
+#define ATA_NIEN            0x02    // device control: no interrupts
+
+#define ATA_CMD_IDENTIFY    0xEC
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_READ_DMA    0xC8
+
+#define ATA_SR_BSY          0x80
+#define ATA_SR_DF           0x20
+#define ATA_SR_DRQ          0x08
+#define ATA_SR_ERR          0x01
+
+#define ATA_SECTOR_SIZE     512
+#define SECTORS_PER_BLOCK   8       // 4KB blocks
+#define ATA_LBA28_MAX       0x0FFFFFFF
+#define ATA_TIMEOUT         1000000 // status reads before a drive is given up on
+
+/* Bus master IDE registers, offsets from BAR4 of the IDE controller */
+#define BM_COMMAND          0x0
+#define BM_STATUS           0x2
+#define BM_PRDT             0x4
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08    // device to memory
+#define BM_ST_ACTIVE        0x01
+#define BM_ST_ERROR         0x02
+#define BM_ST_IRQ           0x04
+#define PRD_LAST            0x8000
+
+#define PCI_CONFIG_ADDR     0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+#define PCI_ENABLE          0x80000000
+#define PCI_CLASS_IDE       0x0101  // mass storage, IDE
+#define PCI_REG_COMMAND     0x04
+#define PCI_REG_CLASS       0x08
+#define PCI_REG_BAR4        0x20
+#define PCI_CMD_IO_BM       0x05    // I/O space and bus master enable
+#define PCI_DEVICES         32
+#define PCI_FUNCTIONS       8
+
+// one physical region descriptor per 4KB buffer
+typedef struct ata_prd_t {
+    uint32_t addr;
+    uint16_t bytes;
+    uint16_t flags;
+} ata_prd_t;
+
+static ata_prd_t prd_table[ATA_MAX_BLOCKS] __attribute__((aligned (64))); // 64B aligned so it can't cross 64KB
+static uint32_t bm_base;            /* Bus master I/O base for the primary channel, 0 to read with PIO */
+static uint32_t disk_blocks;        /* 4KB blocks on the filesystem disk, 0 if there is none */
+static ata_request_t* ata_current;  /* Transfer in flight, NULL if the drive is idle */
+static uint32_t ata_polls;          /* ata_poll calls during the transfer in flight */
+
+/**
+ * ata_wait_status
+ *
+ * Description: Waits for BSY to clear, and for DRQ to set when data is expected
+ * Inputs: drq - 1 to wait for a data request too
+ * Outputs: 0 once ready, -1 on a drive error or timeout
+ * Side Effects: Reads the status register
+ */
+static int32_t ata_wait_status(int32_t drq) {
+    uint32_t status, i;
+
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        status = inb(ATA_COMMAND);
+        if (status & ATA_SR_BSY)
+            continue;
+        if (status & (ATA_SR_ERR | ATA_SR_DF))
+            return -1;
+        if (!drq || (status & ATA_SR_DRQ))
+            return 0;
+    }
+    return -1;
+}
+
+/**
+ * ata_select
+ *
+ * Description: Selects the slave drive and loads the LBA and sector count of a command
+ * Inputs: lba - first sector, sectors - sector count, 0 means 256
+ * Outputs: none
+ * Side Effects: Writes the task file, then waits the 400ns a drive select needs
+ */
+static void ata_select(uint32_t lba, uint32_t sectors) {
+    outb(ATA_DRIVE_SLAVE_LBA | ((lba >> 24) & 0x0F), ATA_DRIVE);
+    inb(ATA_CONTROL);                   // each alternate status read takes 100ns
+    inb(ATA_CONTROL);
+    inb(ATA_CONTROL);
+    inb(ATA_CONTROL);
+    outb(sectors & 0xFF, ATA_SECTOR_COUNT);
+    outb(lba & 0xFF, ATA_LBA_LOW);
+    outb((lba >> 8) & 0xFF, ATA_LBA_MID);
+    outb((lba >> 16) & 0xFF, ATA_LBA_HIGH);
+}
+
+/**
+ * pci_read
+ *
+ * Description: Reads a 32 bit register from PCI configuration space
+ * Inputs: dev - bus 0 device, func - function, reg - register offset
+ * Outputs: Register value
+ * Side Effects: none
+ */
+static uint32_t pci_read(uint32_t dev, uint32_t func, uint32_t reg) {
+    outl(PCI_ENABLE | (dev << 11) | (func << 8) | (reg & 0xFC), PCI_CONFIG_ADDR);
+    return inl(PCI_CONFIG_DATA);
+}
+
+/**
+ * find_bus_master
+ *
+ * Description: Finds the IDE controller on PCI bus 0 and turns on its bus mastering
+ * Inputs: none
+ * Outputs: Bus master I/O base of the primary channel, 0 if there is no controller with one
+ * Side Effects: Writes the controller's PCI command register
+ */
+static uint32_t find_bus_master() {
+    uint32_t dev, func, bar;
+
+    for (dev = 0; dev < PCI_DEVICES; dev++) {
+        for (func = 0; func < PCI_FUNCTIONS; func++) {
+            if ((pci_read(dev, func, 0) & 0xFFFF) == 0xFFFF)
+                continue;               // no device
+            if ((pci_read(dev, func, PCI_REG_CLASS) >> 16) != PCI_CLASS_IDE)
+                continue;
+
+            bar = pci_read(dev, func, PCI_REG_BAR4);
+            if (!(bar & 0x1) || (bar & 0xFFFC) == 0)
+                return 0;               // bus master registers must be in I/O space
+            outl(PCI_ENABLE | (dev << 11) | (func << 8) | PCI_REG_COMMAND, PCI_CONFIG_ADDR);
+            outl(pci_read(dev, func, PCI_REG_COMMAND) | PCI_CMD_IO_BM, PCI_CONFIG_DATA);
+            return bar & 0xFFFC;
+        }
+    }
+    return 0;
+}
+
+/**
+ * ata_init
+ *
+ * Description: Identifies the filesystem disk, the slave on the primary channel, and sets
+ *              up DMA through the IDE bus master. Without a bus master reads use PIO
+ * Inputs: none
+ * Outputs: 0 on success, -1 if there is no ATA disk
+ * Side Effects: Enables IRQ 14 when DMA is used
+ */
+int32_t ata_init() {
+    uint16_t identify[ATA_SECTOR_SIZE / 2];
+    uint32_t i, sectors;
+
+    disk_blocks = 0;
+    ata_current = NULL;
+
+    outb(ATA_NIEN, ATA_CONTROL);        // polled until the drive is known
+    ata_select(0, 0);
+    if (inb(ATA_COMMAND) == 0 || inb(ATA_COMMAND) == 0xFF)
+        return -1;                      // no drive, or a floating bus
+    outb(ATA_CMD_IDENTIFY, ATA_COMMAND);
+    if (inb(ATA_COMMAND) == 0 || ata_wait_status(0))
+        return -1;
+    if (inb(ATA_LBA_MID) || inb(ATA_LBA_HIGH))
+        return -1;                      // ATAPI or SATA, not a plain ATA disk
+    if (ata_wait_status(1))
+        return -1;
+    for (i = 0; i < ATA_SECTOR_SIZE / 2; i++)
+        identify[i] = inw(ATA_DATA);
+
+    // words 60 and 61 hold the LBA28 sector count
+    sectors = identify[60] | (identify[61] << 16);
+    disk_blocks = sectors / SECTORS_PER_BLOCK;
+    if (disk_blocks == 0)
+        return -1;
+
+    bm_base = find_bus_master();
+    if (bm_base) {
+        outb(0, ATA_CONTROL);           // DMA completion is signalled on IRQ 14
+        enable_irq(2);
+        enable_irq(ATA_IRQ);
+    }
+    return 0;
+}
+
+/**
+ * ata_num_blocks
+ *
+ * Description: Returns the size of the filesystem disk
+ * Inputs: none
+ * Outputs: 4KB blocks on the disk, 0 if ata_init found none
+ * Side Effects: none
+ */
+uint32_t ata_num_blocks() {
+    return disk_blocks;
+}
+
+/**
+ * ata_busy
+ *
+ * Description: Tells if a transfer is in flight
+ * Inputs: none
+ * Outputs: 1 if a transfer is in flight, 0 if the drive is idle
+ * Side Effects: none
+ */
+int32_t ata_busy() {
+    return ata_current != NULL;
+}
+
+/**
+ * ata_finish
+ *
+ * Description: Ends the transfer in flight and hands its status to the request's owner
+ * Inputs: status - 0 on success, -1 on an error
+ * Outputs: none
+ * Side Effects: Clears ata_current, calls the request's done function
+ */
+static void ata_finish(int32_t status) {
+    ata_request_t* req = ata_current;
+
+    ata_current = NULL;
+    req->status = status;
+    if (req->done != NULL)
+        req->done(req);
+}
+
+/**
+ * ata_read_pio
+ *
+ * Description: Reads a request's blocks one sector at a time through the data port
+ * Inputs: req - request with its task file already loaded
+ * Outputs: 0 on success, -1 on a drive error
+ * Side Effects: Fills the request's buffers
+ */
+static int32_t ata_read_pio(ata_request_t* req) {
+    uint32_t blk, sector, i;
+    uint16_t* buf;
+
+    outb(ATA_CMD_READ_PIO, ATA_COMMAND);
+    for (blk = 0; blk < req->count; blk++) {
+        buf = (uint16_t*)req->bufs[blk];
+        for (sector = 0; sector < SECTORS_PER_BLOCK; sector++) {
+            if (ata_wait_status(1))
+                return -1;
+            for (i = 0; i < ATA_SECTOR_SIZE / 2; i++)
+                *buf++ = inw(ATA_DATA);
+        }
+    }
+    return 0;
+}
+
+/**
+ * ata_submit
+ *
+ * Description: Starts reading a request's blocks. With a bus master the read is a single
+ *              DMA scattered into the buffers, finished later by ata_irq or ata_poll.
+ *              With PIO it is finished before returning
+ * Inputs: req - request, its status becomes ATA_PENDING
+ * Outputs: 0 if the read was started, -1 for a bad request or busy drive
+ * Side Effects: Programs the drive and bus master. Callers keep interrupts off
+ */
+int32_t ata_submit(ata_request_t* req) {
+    uint32_t lba, i;
+
+    if (req == NULL || ata_current != NULL || req->count == 0 || req->count > ATA_MAX_BLOCKS ||
+        req->block >= disk_blocks || req->count > disk_blocks - req->block)
+        return -1;
+    lba = req->block * SECTORS_PER_BLOCK;
+    if (lba + req->count * SECTORS_PER_BLOCK > ATA_LBA28_MAX)
+        return -1;
+
+    req->status = ATA_PENDING;
+    ata_current = req;
+    ata_polls = 0;
+    if (ata_wait_status(0)) {
+        ata_finish(-1);
+        return 0;
+    }
+    ata_select(lba, req->count * SECTORS_PER_BLOCK);
+
+    if (!bm_base) {
+        ata_finish(ata_read_pio(req));
+        return 0;
+    }
+
+    // kernel memory is identity mapped, so buffer addresses are physical
+    for (i = 0; i < req->count; i++) {
+        prd_table[i].addr = (uint32_t)req->bufs[i];
+        prd_table[i].bytes = ATA_BLOCK_SIZE;
+        prd_table[i].flags = (i == req->count - 1) ? PRD_LAST : 0;
+    }
+    outb(0, bm_base + BM_COMMAND);
+    outl((uint32_t)prd_table, bm_base + BM_PRDT);
+    outb(BM_ST_ERROR | BM_ST_IRQ, bm_base + BM_STATUS);    // write 1 to clear
+    outb(BM_CMD_READ, bm_base + BM_COMMAND);
+    outb(ATA_CMD_READ_DMA, ATA_COMMAND);
+    outb(BM_CMD_READ | BM_CMD_START, bm_base + BM_COMMAND);
+    return 0;
+}
+
+/**
+ * ata_dma_done
+ *
+ * Description: Finishes the DMA in flight if the bus master says the drive has interrupted
+ * Inputs: force - 1 to give up on a transfer that never completes
+ * Outputs: none
+ * Side Effects: Stops the bus master and clears the drive's interrupt
+ */
+static void ata_dma_done(int32_t force) {
+    uint32_t bm_status, status;
+
+    if (ata_current == NULL || !bm_base)
+        return;
+    bm_status = inb(bm_base + BM_STATUS);
+    if (!force && (!(bm_status & BM_ST_IRQ) || (bm_status & BM_ST_ACTIVE)))
+        return;
+
+    outb(0, bm_base + BM_COMMAND);
+    status = inb(ATA_COMMAND);          // reading status acknowledges the drive
+    outb(BM_ST_ERROR | BM_ST_IRQ, bm_base + BM_STATUS);
+    ata_finish((force || (bm_status & BM_ST_ERROR) || (status & (ATA_SR_ERR | ATA_SR_DF))) ? -1 : 0);
+}
+
+/**
+ * ata_poll
+ *
+ * Description: Finishes the transfer in flight without waiting for IRQ 14, for callers
+ *              that run with interrupts off such as the page fault handler
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: May finish the transfer, fails it after ATA_TIMEOUT polls
+ */
+void ata_poll() {
+    if (ata_current == NULL)
+        return;
+    ata_dma_done(++ata_polls >= ATA_TIMEOUT);
+}
+
+/**
+ * ata_irq
+ *
+ * Description: Processes the interrupt request from IRQ 14, the end of a DMA
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Finishes the transfer in flight, sends EOI
+ */
+void ata_irq() {
+    if (ata_current != NULL)
+        ata_dma_done(0);
+    else
+        inb(ATA_COMMAND);               // late interrupt of a transfer ata_poll already finished
+    send_eoi(ATA_IRQ);
+}
@@ -0,0 +1,40 @@
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+#include "lib.h"
+#include "i8259.h"
+
+#define ATA_IRQ                 14
+#define ATA_BLOCK_SIZE          4096 // filesystem block, BLOCK_SIZE in filesys.h
+#define ATA_MAX_BLOCKS          8    // 4KB blocks in one transfer, one PRD entry each
+#define ATA_PENDING             1    // ata_request_t status until the transfer finishes
+
+// read of consecutive 4KB blocks of the filesystem disk
+typedef struct ata_request_t {
+    uint32_t block; // first 4KB block on the disk
+    uint32_t count; // blocks, 1 to ATA_MAX_BLOCKS
+    uint8_t* bufs[ATA_MAX_BLOCKS]; // 4KB aligned kernel buffer for each block
+    volatile int32_t status; // ATA_PENDING, then 0 or -1
+    void (*done)(struct ata_request_t* req); // called with interrupts off once status is set
+} ata_request_t;
+
+// Finds the filesystem disk and the IDE bus master, enables IRQ 14
+int32_t ata_init();
+
+// Size of the filesystem disk in 4KB blocks
+uint32_t ata_num_blocks();
+
+// 1 while a transfer is in flight
+int32_t ata_busy();
+
+// Starts a read, with interrupts off and no transfer in flight
+int32_t ata_submit(ata_request_t* req);
+
+// Finishes the transfer in flight if the controller is done, with interrupts off
+void ata_poll();
+
+// Processes the interrupt request from IRQ 14
+void ata_irq();
+
+#endif /* _ATA_H */
@@ -0,0 +1,207 @@
+#include "bcache.h"
+#include "scheduler.h"
+
+#define BCACHE_EMPTY        0
+#define BCACHE_LOADING      1   // part of the transfer in flight
+#define BCACHE_VALID        2
+#define BCACHE_FAILED       3   // its transfer failed, the next reader reports it
+#define EFLAGS_IF           0x200
+
+typedef struct bcache_entry_t {
+    uint32_t block;
+    uint32_t state;
+    uint32_t last_used; /* bcache_clock at the last hit, lowest is evicted */
+} bcache_entry_t;
+
+static bcache_entry_t bcache[BCACHE_ENTRIES];
+static uint8_t bcache_data[BCACHE_ENTRIES][ATA_BLOCK_SIZE] __attribute__((aligned (ATA_BLOCK_SIZE))); /* DMA targets */
+static uint32_t bcache_clock;
+static uint32_t bcache_blocks;      /* Blocks on the disk */
+static uint32_t next_sequential;    /* Block right after the last miss's transfer, a miss here reads ahead */
+static ata_request_t bcache_req;    /* Only one transfer is ever in flight */
+static bcache_entry_t* req_entries[ATA_MAX_BLOCKS]; /* Entries filled by bcache_req */
+static bcache_stats_t bcache_stats;
+static wait_queue_t bcache_queue;   /* Readers sleeping until the transfer in flight finishes */
+
+/**
+ * bcache_io_done
+ *
+ * Description: Marks the entries of a finished transfer valid, or failed, and wakes the
+ *              readers waiting for the drive. Runs in whatever context finished the
+ *              transfer, IRQ 14 or a poller, so no reader waits on the process that started it
+ * Inputs: req - the finished request
+ * Outputs: none
+ * Side Effects: Changes entry states, moves the sleeping readers to the run queue
+ */
+static void bcache_io_done(ata_request_t* req) {
+    uint32_t i;
+
+    for (i = 0; i < req->count; i++)
+        req_entries[i]->state = req->status ? BCACHE_FAILED : BCACHE_VALID;
+    if (req->status)
+        bcache_stats.errors++;
+    wake_up(&bcache_queue);
+}
+
+/**
+ * find_entry
+ *
+ * Description: Linear search of the cache, it only holds BCACHE_ENTRIES blocks
+ * Inputs: block - disk block
+ * Outputs: Entry holding or loading the block, NULL if there is none
+ * Side Effects: none
+ */
+static bcache_entry_t* find_entry(uint32_t block) {
+    uint32_t i;
+
+    for (i = 0; i < BCACHE_ENTRIES; i++) {
+        if (bcache[i].state != BCACHE_EMPTY && bcache[i].block == block)
+            return &bcache[i];
+    }
+    return NULL;
+}
+
+/**
+ * start_read
+ *
+ * Description: Claims the least recently used entries for a missed block, and the blocks
+ *              after it when the miss continues a sequential read, and starts one transfer
+ * Inputs: block - missed disk block
+ * Outputs: 0 if the transfer was started, -1 if the drive refused it
+ * Side Effects: Evicts entries. Callers keep interrupts off and the drive idle
+ */
+static int32_t start_read(uint32_t block) {
+    bcache_entry_t* victim;
+    uint32_t count, max, i;
+
+    max = (block == next_sequential) ? BCACHE_READAHEAD : 1;
+    if (max > bcache_blocks - block)
+        max = bcache_blocks - block;
+
+    for (count = 0; count < max; count++) {
+        // read ahead stops at the first block that is already cached
+        if (count > 0 && find_entry(block + count) != NULL)
+            break;
+        victim = NULL;
+        for (i = 0; i < BCACHE_ENTRIES; i++) {
+            if (bcache[i].state == BCACHE_LOADING)
+                continue;
+            if (victim == NULL || bcache[i].state == BCACHE_EMPTY ||
+                (victim->state != BCACHE_EMPTY && bcache[i].last_used < victim->last_used))
+                victim = &bcache[i];
+            if (victim->state == BCACHE_EMPTY)
+                break;
+        }
+        victim->state = BCACHE_LOADING;
+        victim->block = block + count;
+        victim->last_used = ++bcache_clock;
+        req_entries[count] = victim;
+        bcache_req.bufs[count] = bcache_data[victim - bcache];
+    }
+
+    bcache_req.block = block;
+    bcache_req.count = count;
+    bcache_req.done = bcache_io_done;
+    if (ata_submit(&bcache_req)) {
+        for (i = 0; i < count; i++)
+            req_entries[i]->state = BCACHE_EMPTY;
+        return -1;
+    }
+    bcache_stats.misses++;
+    bcache_stats.readahead += count - 1;
+    next_sequential = block + count;
+    return 0;
+}
+
+/**
+ * bcache_init
+ *
+ * Description: Empties the cache
+ * Inputs: num_blocks - 4KB blocks on the disk
+ * Outputs: 0 on success, -1 for an empty disk
+ * Side Effects: Clears every entry and counter
+ */
+int32_t bcache_init(uint32_t num_blocks) {
+    if (num_blocks == 0)
+        return -1;
+    memset(bcache, 0, sizeof(bcache));
+    memset(&bcache_stats, 0, sizeof(bcache_stats));
+    bcache_blocks = num_blocks;
+    bcache_clock = 0;
+    next_sequential = 0;
+    return 0;
+}
+
+/**
+ * bcache_read
+ *
+ * Description: Copies bytes out of a disk block, reading it in on a miss. A caller with
+ *              interrupts on sleeps until IRQ 14 finishes the transfer, one with them off
+ *              (the page fault handler, or a write holding the filesystem) polls the drive
+ * Inputs: block - disk block
+ *         offset - byte offset within the block
+ *         buf - buffer to copy into
+ *         length - bytes to copy, offset + length at most ATA_BLOCK_SIZE
+ * Outputs: length on success, -1 for a bad block or a failed read
+ * Side Effects: May evict entries and start a transfer
+ */
+int32_t bcache_read(uint32_t block, uint32_t offset, void* buf, uint32_t length) {
+    bcache_entry_t* entry;
+    uint32_t flags;
+
+    if (buf == NULL || block >= bcache_blocks || offset > ATA_BLOCK_SIZE || length > ATA_BLOCK_SIZE - offset)
+        return -1;
+
+    cli_and_save(flags);
+    while (1) {
+        entry = find_entry(block);
+        if (entry != NULL && entry->state == BCACHE_VALID) {
+            // most recently used before the copy, a fault on buf reading through the cache
+            // evicts other entries first
+            entry->last_used = ++bcache_clock;
+            memcpy(buf, bcache_data[entry - bcache] + offset, length);
+            bcache_stats.hits++;
+            restore_flags(flags);
+            return length;
+        }
+        if (entry != NULL && entry->state == BCACHE_FAILED) {
+            entry->state = BCACHE_EMPTY;
+            restore_flags(flags);
+            return -1;
+        }
+
+        // the block is loading, or the drive is busy with other blocks. Interrupts stay off
+        // from the check to the sleep, so the IRQ 14 wakeup can't be missed
+        if (ata_busy()) {
+            if (flags & EFLAGS_IF)
+                sleep_on(&bcache_queue);
+            else
+                ata_poll();
+            continue;
+        }
+
+        if (entry == NULL && start_read(block)) {
+            bcache_stats.errors++;
+            restore_flags(flags);
+            return -1;
+        }
+    }
+}
+
+/**
+ * bcache_get_stats
+ *
+ * Description: Copies the buffer cache counters
+ * Inputs: stats - filled with the counters
+ * Outputs: none
+ * Side Effects: none
+ */
+void bcache_get_stats(bcache_stats_t* stats) {
+    uint32_t flags;
+
+    if (stats == NULL)
+        return;
+    cli_and_save(flags);
+    *stats = bcache_stats;
+    restore_flags(flags);
+}
@@ -0,0 +1,28 @@
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include "types.h"
+#include "lib.h"
+#include "ata.h"
+
+#define BCACHE_ENTRIES          64   // 256KB of cached disk blocks
+#define BCACHE_READAHEAD        ATA_MAX_BLOCKS // blocks read by a miss right after the last read
+
+// counters for the buffer cache, read with bcache_get_stats
+typedef struct bcache_stats_t {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead; // blocks read in before they were asked for
+    uint32_t errors;
+} bcache_stats_t;
+
+// Empties the cache in front of a disk of num_blocks 4KB blocks
+int32_t bcache_init(uint32_t num_blocks);
+
+// Copies length bytes at offset within a disk block, reading the block in on a miss
+int32_t bcache_read(uint32_t block, uint32_t offset, void* buf, uint32_t length);
+
+// Copies the cache counters into stats
+void bcache_get_stats(bcache_stats_t* stats);
+
+#endif /* _BCACHE_H */
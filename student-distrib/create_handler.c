@@ -55,6 +55,7 @@ void init_idt() {
     SET_IDT_ENTRY(idt[0x20], pitInterrupt);
     SET_IDT_ENTRY(idt[0x21], keyboardInterrupt); //calling IDT for keyboard interrupt 
     SET_IDT_ENTRY(idt[0x28], rtcInterrupt); //calling IDT for RTC interrupt 
+    SET_IDT_ENTRY(idt[0x2E], ataInterrupt); //calling IDT for ATA disk interrupt
     SET_IDT_ENTRY(idt[0x80], systemCall); //calling IDT for system call
 
 }
@@ -154,24 +155,29 @@ void handler(int except_num) {
 /** 
  * page_fault_handler
  * 
- * Description: Shows additional information about the exit status at a page fault to assist in debugging
+ * Description: Demand pages user memory, otherwise shows additional information about
+ *              the exit status at a page fault to assist in debugging
  * Inputs: except_num, error_code, eip
  * Outputs: none
  */
 void page_fault_handler(int except_num, int error_code, int eip) {
     int CR2;
     int ESP;
-    switch(except_num) {
-        case 0x0E: //Exception number 14 - Page Fault Exception
-            
-            // get register values from assembly
-            asm volatile(
-                "movl %%cr2, %0;"
-                "movl %%esp, %1;"
 
-                : "=r"(CR2), "=r"(ESP)
-            );
+    // get register values from assembly
+    asm volatile(
+        "movl %%cr2, %0;"
+        "movl %%esp, %1;"
+
+        : "=r"(CR2), "=r"(ESP)
+    );
+
+    // missing pages of the user program are loaded on first touch, retry the instruction
+    if (except_num == 0x0E && handle_user_page_fault(CR2, error_code) == 0)
+        return;
 
+    switch(except_num) {
+        case 0x0E: //Exception number 14 - Page Fault Exception
             printf("Error: Page Fault Exception \n");
             printf("Error code: %x", error_code);
             printf("\nEIP: %x ", eip);
@@ -208,6 +214,10 @@ void irq_handler(int irq_num) {
         case 0x28: //Interrupt number 40 - RTC interrupt 
             rtc_irq(); //Calls the RTC function 
             break;
+
+        case 0x2E: //Interrupt number 46 - ATA disk interrupt, the end of a DMA
+            ata_irq();
+            break;
         
         default: //Default interrupt 
             printf("Default irq");
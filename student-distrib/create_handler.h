@@ -9,6 +9,7 @@
 #include "rtc.h"
 #include "system_call.h"
 #include "pit.h"
+#include "ata.h"
 
 
 // initializes idt
@@ -91,6 +92,9 @@ extern void rtcInterrupt();
 // sets for Interrupt 0x20
 extern void pitInterrupt();
 
+// sets for Interrupt 0x2E (46)
+extern void ataInterrupt();
+
 
 #endif /* _HANDLER_H */
 
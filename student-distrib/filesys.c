@@ -1,30 +1,851 @@
 #include "filesys.h"
 #include "system_call.h"
+#include "bcache.h"
 
 static uint8_t* dataBlock_start; /* Pointer to data block */
-static bootBlock_t* boot_block_ptr; /* Pointer to boot block */
+static uint8_t* inode_start; /* Pointer to inode 0 */
+static dentry_t* module_dentries; /* Pointer to dentry 0, in the boot block for v1 */
+static uint32_t fs_version; /* 1 or FS_VERSION_2, from the boot block */
+static uint32_t num_module_inodes; /* n from the boot block */
+static uint32_t num_data_blocks; /* d from the boot block */
+static uint16_t dentry_hash[DENTRY_HASH_SIZE]; /* Dentry index + 1 for each hash slot, 0 if slot is empty */
+static extent_t extents[MAX_EXTENTS]; /* Extent lists of every inode, back to back */
+static uint16_t extent_first[MAX_EXTENT_INODES]; /* Index of an inode's first extent */
+static uint16_t extent_count[MAX_EXTENT_INODES]; /* Number of extents, 0 if the inode has no extent list */
+
+/* Writable overlay, the module itself is never written */
+static uint8_t overlay_blocks[OVERLAY_BLOCKS][BLOCK_SIZE] __attribute__((aligned (BLOCK_SIZE))); /* Copied and new data blocks */
+static uint32_t overlay_block_map[OVERLAY_BLOCKS / 32]; /* Bit set for each overlay block in use */
+static inode_t overlay_inodes[OVERLAY_INODES]; /* Copies of written module inodes and inodes of new files */
+static uint32_t num_overlay_inodes; /* Overlay inodes handed out so far */
+static uint8_t overlay_inode_idx[MAX_EXTENT_INODES]; /* Overlay inode index + 1 for each inode number, 0 if clean */
+static dentry_t overlay_dentries[OVERLAY_DENTRIES]; /* Dentries of new files, listed after the module's */
+static uint32_t num_overlay_dentries; /* Dentries created so far */
+static uint32_t num_module_dentries; /* Dentries in the module, capped at MAX_DENTRIES or MAX_DENTRIES_V2 */
+
+/* Filesystem read from the disk through the buffer cache when there is no module */
+static uint32_t fs_on_disk; /* 1 if module inodes and data blocks are only on the disk */
+static uint32_t disk_inode_block; /* Disk block of inode 0 */
+static uint32_t disk_data_block; /* Disk block of data block 0 */
+static uint32_t disk_boot_block[BLOCK_SIZE / 4]; /* Boot block, read once at init */
+static dentry_t disk_dentries[MAX_DENTRIES_V2]; /* v2 directory, read once at init */
+
+/* Compressed files, decompressed a chunk at a time into a small cache */
+typedef struct zcache_entry_t {
+    uint32_t valid;
+    uint32_t inode;
+    uint32_t chunk;
+    uint32_t last_used; /* zcache_clock at the last hit, lowest is evicted */
+    uint8_t data[BLOCK_SIZE];
+} zcache_entry_t;
+
+static uint32_t inode_compressed[MAX_EXTENT_INODES / 32]; /* Bit set for each inode of a FILE_COMPRESSED dentry */
+static zcache_entry_t zcache[ZCACHE_ENTRIES];
+static uint32_t zcache_clock;
+static uint8_t zchunk_buf[BLOCK_SIZE]; /* Compressed chunk gathered from its stream blocks */
+
+
+/** 
+ * hash_file_name
+ * 
+ * Description: FNV-1a hash of a file name, stopping at NULL or MAX_FILE_NAME_LEN chars
+ * 
+ * Inputs: fname - name to hash
+ *         len - filled with number of chars hashed, MAX_FILE_NAME_LEN + 1 if name is too long
+ * 
+ * Outputs: hash of the name
+ * 
+ * Side Effects: None
+ */
+static uint32_t hash_file_name(const int8_t* fname, uint32_t* len) {
+    uint32_t hash = 2166136261U;    // FNV offset basis
+    uint32_t i;
+
+    for (i = 0; i < MAX_FILE_NAME_LEN && fname[i] != NULL; i++) {
+        hash ^= (uint8_t)fname[i];
+        hash *= 16777619;           // FNV prime
+    }
+    // dentry names may fill all 32 bytes, but a name passed in must be NULL terminated by then
+    if (len != NULL)
+        *len = (i == MAX_FILE_NAME_LEN && fname[i] != NULL) ? MAX_FILE_NAME_LEN + 1 : i;
+
+    return hash;
+}
+
+
+/** 
+ * get_inode
+ * 
+ * Description: Finds a block list inode, the overlay copy if the file was written or created
+ *              after boot, otherwise the module's inode in a v1 filesystem
+ * 
+ * Inputs: inode - inode number
+ * 
+ * Outputs: Pointer to the inode, NULL for a bad inode number, a v2 module inode or a module
+ *          inode on the disk
+ * 
+ * Side Effects: None
+ */
+static inode_t* get_inode(uint32_t inode) {
+    if (inode < MAX_EXTENT_INODES && overlay_inode_idx[inode])
+        return &overlay_inodes[overlay_inode_idx[inode] - 1];
+    if (inode >= num_module_inodes || fs_version == FS_VERSION_2 || fs_on_disk)
+        return NULL;
+    return (inode_t*)(inode_start + inode*BLOCK_SIZE);
+}
+
+/** 
+ * get_inode_v2
+ * 
+ * Description: Finds an extent inode of a v2 filesystem that was not written after boot
+ * 
+ * Inputs: inode - inode number
+ * 
+ * Outputs: Pointer to the inode, NULL for a bad inode number, an overlay inode, a v1 filesystem
+ *          or a filesystem on the disk
+ * 
+ * Side Effects: None
+ */
+static inodeV2_t* get_inode_v2(uint32_t inode) {
+    if (fs_version != FS_VERSION_2 || inode >= num_module_inodes || fs_on_disk)
+        return NULL;
+    if (inode < MAX_EXTENT_INODES && overlay_inode_idx[inode])
+        return NULL;
+    return (inodeV2_t*)(inode_start + inode*BLOCK_SIZE);
+}
+
+/** 
+ * find_extent
+ * 
+ * Description: Binary search of a sorted extent list for the extent holding a block
+ * 
+ * Inputs: list - extents sorted by fileBlock
+ *         count - number of extents in list
+ *         blockIdx - index of the block within the file
+ * 
+ * Outputs: The extent holding blockIdx, NULL if no extent does
+ * 
+ * Side Effects: None
+ */
+static extent_t* find_extent(extent_t* list, uint32_t count, uint32_t blockIdx) {
+    uint32_t lo, hi, mid;
+
+    if (count == 0 || blockIdx < list[0].fileBlock)
+        return NULL;
+
+    // last extent starting at or before blockIdx
+    lo = 0;
+    hi = count;
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (list[mid].fileBlock <= blockIdx) lo = mid;
+        else hi = mid;
+    }
+    if (blockIdx - list[lo].fileBlock >= list[lo].numBlocks)
+        return NULL;
+    return &list[lo];
+}
+
+/** 
+ * get_zinode
+ * 
+ * Description: Finds the inode of a compressed file that was not written after boot
+ * 
+ * Inputs: inode - inode number
+ * 
+ * Outputs: Pointer to the inode, NULL if the file is not compressed, was copied to the overlay
+ *          or is on the disk
+ * 
+ * Side Effects: None
+ */
+static zinode_t* get_zinode(uint32_t inode) {
+    if (inode >= MAX_EXTENT_INODES || inode >= num_module_inodes || !(inode_compressed[inode / 32] & (1 << (inode % 32))) || fs_on_disk)
+        return NULL;
+    if (overlay_inode_idx[inode])
+        return NULL;
+    return (zinode_t*)(inode_start + inode*BLOCK_SIZE);
+}
+
+/** 
+ * is_disk_inode
+ * 
+ * Description: Tells if an inode has to be read from the disk
+ * 
+ * Inputs: inode - inode number
+ * 
+ * Outputs: 1 for a module inode of a filesystem on the disk that was not written after boot, else 0
+ * 
+ * Side Effects: None
+ */
+static int32_t is_disk_inode(uint32_t inode) {
+    if (!fs_on_disk || inode >= num_module_inodes)
+        return 0;
+    return !(inode < MAX_EXTENT_INODES && overlay_inode_idx[inode]);
+}
+
+/** 
+ * get_disk_file_len
+ * 
+ * Description: Reads the length of a file from its inode on the disk
+ * 
+ * Inputs: inode - inode number of a disk inode
+ * 
+ * Outputs: Length of file in bytes, clamped to MAX_FILE_POS, -1 if the inode can't be read
+ * 
+ * Side Effects: May read the inode's block into the buffer cache
+ */
+static int32_t get_disk_file_len(uint32_t inode) {
+    uint32_t length[2]; // v1 and compressed inodes have only the low word
+
+    if (bcache_read(disk_inode_block + inode, 0, length, sizeof(length)) < 0)
+        return -1;
+    if (fs_version == FS_VERSION_2 && !(inode < MAX_EXTENT_INODES && (inode_compressed[inode / 32] & (1 << (inode % 32)))) && length[1])
+        return MAX_FILE_POS;
+    return (length[0] > MAX_FILE_POS) ? MAX_FILE_POS : length[0];
+}
+
+/** 
+ * get_disk_file_run
+ * 
+ * Description: Finds the run of consecutive data blocks holding the blockIdx'th block of a
+ *              file on the disk, from a v1 block list or a binary search of v2 extents
+ * 
+ * Inputs: inode - inode number of a disk inode
+ *         blockIdx - index of the block within the file
+ *         numBlocks - blocks in the file
+ *         dataBlock - filled with the data block number of the blockIdx'th block
+ * 
+ * Outputs: Number of contiguous blocks from blockIdx on, -1 for a bad inode or data block number
+ * 
+ * Side Effects: May read the inode's block into the buffer cache
+ */
+static int32_t get_disk_file_run(uint32_t inode, uint32_t blockIdx, uint32_t numBlocks, uint32_t* dataBlock) {
+    uint32_t blocks[DISK_RUN_BATCH], count, lo, hi, mid, run;
+    uint32_t inode_block = disk_inode_block + inode;
+    extent_t cur;
+
+    if (fs_version != FS_VERSION_2) {
+        // a batch of the block list at a time, the run ends at the first gap
+        if (blockIdx >= MAX_DATA_BLOCKS) return -1;
+        count = numBlocks - blockIdx;
+        if (count > DISK_RUN_BATCH) count = DISK_RUN_BATCH;
+        if (count > MAX_DATA_BLOCKS - blockIdx) count = MAX_DATA_BLOCKS - blockIdx;
+        if (bcache_read(inode_block, sizeof(uint32_t) * (1 + blockIdx), blocks, count * sizeof(uint32_t)) < 0)
+            return -1;
+        for (run = 1; run < count && blocks[run] == blocks[0] + run; run++);
+        *dataBlock = blocks[0];
+    } else {
+        if (bcache_read(inode_block, INODE_V2_NUM_EXTENTS, &count, sizeof(count)) < 0)
+            return -1;
+        if (count > V2_INODE_EXTENTS) count = V2_INODE_EXTENTS;
+
+        // last extent starting at or before blockIdx, like find_extent
+        lo = 0;
+        hi = count;
+        while (hi - lo > 1) {
+            mid = (lo + hi) / 2;
+            if (bcache_read(inode_block, INODE_V2_EXTENTS + mid * sizeof(extent_t), &cur, sizeof(cur)) < 0)
+                return -1;
+            if (cur.fileBlock <= blockIdx) lo = mid;
+            else hi = mid;
+        }
+        if (count == 0 || bcache_read(inode_block, INODE_V2_EXTENTS + lo * sizeof(extent_t), &cur, sizeof(cur)) < 0)
+            return -1;
+        if (blockIdx < cur.fileBlock || blockIdx - cur.fileBlock >= cur.numBlocks)
+            return -1;
+        *dataBlock = cur.dataBlock + (blockIdx - cur.fileBlock);
+        run = cur.numBlocks - (blockIdx - cur.fileBlock);
+    }
+
+    if (*dataBlock >= num_data_blocks || run > num_data_blocks - *dataBlock)
+        return -1;
+    if (run > numBlocks - blockIdx)
+        run = numBlocks - blockIdx;
+    return run;
+}
+
+/** 
+ * touch_buffer
+ * 
+ * Description: Writes the first and last byte of a buffer no longer than a page back to
+ *              themselves, so both pages it can span are present before a copy into it
+ * 
+ * Inputs: buf - buffer about to be copied into
+ *         length - its length, 1 to BLOCK_SIZE
+ * 
+ * Outputs: None
+ * 
+ * Side Effects: Demand pages in the buffer's pages
+ */
+static void touch_buffer(uint8_t* buf, uint32_t length) {
+    volatile uint8_t* first = buf;
+    volatile uint8_t* last = buf + length - 1;
+
+    *first = *first;
+    *last = *last;
+}
+
+/** 
+ * read_disk_data
+ * 
+ * Description: Copies bytes of a file on the disk through the buffer cache, a block at a time
+ * 
+ * Inputs: inode - inode number of a disk inode
+ *         offset - offset in file to begin reading from
+ *         buf - buffer to read data into
+ *         length - length of bytes to read, already clamped to the file length
+ *         file_len - length of the file
+ * 
+ * Outputs: Number of bytes read on success, -1 for a bad or unreadable block
+ * 
+ * Side Effects: Fills buf, may read blocks into the buffer cache
+ */
+static int32_t read_disk_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t file_len) {
+    uint32_t bytes_read, blockIdx, blockOffset, dataBlock, chunk, numBlocks;
+    int32_t run;
+
+    // compressed chunks straddle blocks, they are only decoded from a module
+    if (inode < MAX_EXTENT_INODES && (inode_compressed[inode / 32] & (1 << (inode % 32))))
+        return -1;
+
+    numBlocks = (file_len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blockIdx = offset / BLOCK_SIZE;
+    blockOffset = offset % BLOCK_SIZE;
+    for (bytes_read = 0; bytes_read < length; ) {
+        if ((run = get_disk_file_run(inode, blockIdx, numBlocks, &dataBlock)) <= 0)
+            return -1;
+        for (; run > 0 && bytes_read < length; run--, blockIdx++, dataBlock++) {
+            chunk = BLOCK_SIZE - blockOffset;
+            if (chunk > length - bytes_read) {
+                chunk = length - bytes_read;
+            }
+            // fault in the destination first, the page fault handler reads through the
+            // buffer cache and could reuse the entry this copies from
+            touch_buffer(buf + bytes_read, chunk);
+            if (bcache_read(disk_data_block + dataBlock, blockOffset, buf + bytes_read, chunk) < 0)
+                return -1;
+            bytes_read += chunk;
+            blockOffset = 0;
+        }
+    }
+
+    return bytes_read;
+}
+
+/** 
+ * get_dentry
+ * 
+ * Description: Finds a dentry, indexes past the boot block's dentries are overlay dentries
+ * 
+ * Inputs: index - dentry index
+ * 
+ * Outputs: Pointer to the dentry, NULL past the last dentry
+ * 
+ * Side Effects: None
+ */
+static dentry_t* get_dentry(uint32_t index) {
+    if (index < num_module_dentries)
+        return &module_dentries[index];
+    if (index - num_module_dentries < num_overlay_dentries)
+        return &overlay_dentries[index - num_module_dentries];
+    return NULL;
+}
+
+/** 
+ * get_block_addr
+ * 
+ * Description: Returns the address of a data block, from the module or the overlay
+ * 
+ * Inputs: blockNum - data block number from an inode
+ * 
+ * Outputs: Pointer to the 4KB data block, NULL for a bad block number
+ * 
+ * Side Effects: None
+ */
+static uint8_t* get_block_addr(uint32_t blockNum) {
+    if (blockNum & OVERLAY_BLOCK_FLAG) {
+        blockNum &= ~OVERLAY_BLOCK_FLAG;
+        return (blockNum < OVERLAY_BLOCKS) ? overlay_blocks[blockNum] : NULL;
+    }
+    return (blockNum < num_data_blocks && !fs_on_disk) ? dataBlock_start + blockNum*BLOCK_SIZE : NULL;
+}
+
+/** 
+ * alloc_overlay_block
+ * 
+ * Description: Takes a free block from the overlay block bitmap and zeroes it
+ * 
+ * Inputs: None
+ * 
+ * Outputs: Data block number with OVERLAY_BLOCK_FLAG set, 0 if the overlay is full
+ * 
+ * Side Effects: Marks the block used
+ */
+static uint32_t alloc_overlay_block() {
+    uint32_t i, j;
+
+    for (i = 0; i < OVERLAY_BLOCKS / 32; i++) {
+        if (overlay_block_map[i] == 0xFFFFFFFF) continue;
+        for (j = 0; overlay_block_map[i] & (1 << j); j++);
+        overlay_block_map[i] |= 1 << j;
+        memset(overlay_blocks[i*32 + j], 0, BLOCK_SIZE);
+        return (i*32 + j) | OVERLAY_BLOCK_FLAG;
+    }
+    return 0;
+}
+
+/** 
+ * free_overlay_block
+ * 
+ * Description: Returns a block taken by alloc_overlay_block to the overlay block bitmap
+ * 
+ * Inputs: blockNum - data block number with OVERLAY_BLOCK_FLAG set
+ * 
+ * Outputs: None
+ * 
+ * Side Effects: Marks the block free
+ */
+static void free_overlay_block(uint32_t blockNum) {
+    blockNum &= ~OVERLAY_BLOCK_FLAG;
+    if (blockNum < OVERLAY_BLOCKS)
+        overlay_block_map[blockNum / 32] &= ~(1 << (blockNum % 32));
+}
+
+/** 
+ * lz4_decompress
+ * 
+ * Description: Decodes one LZ4 block: sequences of a token, literals and a match copied
+ *              from earlier output. Every length and offset is bounds checked
+ * 
+ * Inputs: src - compressed block
+ *         srcLen - length of src
+ *         dst - output buffer
+ *         dstLen - size of dst
+ * 
+ * Outputs: Number of bytes decoded, -1 for a corrupt block
+ * 
+ * Side Effects: Fills dst
+ */
+static int32_t lz4_decompress(const uint8_t* src, uint32_t srcLen, uint8_t* dst, uint32_t dstLen) {
+    uint32_t srcPos = 0, dstPos = 0, len, offset;
+    uint8_t token, extra;
+
+    while (srcPos < srcLen) {
+        token = src[srcPos++];
+
+        // literal length in the high nibble, 15 means more length bytes follow
+        len = token >> 4;
+        if (len == 15) {
+            do {
+                if (srcPos >= srcLen) return -1;
+                extra = src[srcPos++];
+                len += extra;
+            } while (extra == 255);
+        }
+        if (len > srcLen - srcPos || len > dstLen - dstPos) return -1;
+        memcpy(dst + dstPos, src + srcPos, len);
+        srcPos += len;
+        dstPos += len;
+
+        // the last sequence is literals only
+        if (srcPos == srcLen) break;
+
+        if (srcLen - srcPos < 2) return -1;
+        offset = src[srcPos] | (src[srcPos + 1] << 8);
+        srcPos += 2;
+        if (offset == 0 || offset > dstPos) return -1;
+
+        // match length in the low nibble, plus the 4 byte minimum match
+        len = token & 0xF;
+        if (len == 15) {
+            do {
+                if (srcPos >= srcLen) return -1;
+                extra = src[srcPos++];
+                len += extra;
+            } while (extra == 255);
+        }
+        len += 4;
+        if (len > dstLen - dstPos) return -1;
+
+        // byte at a time, a match may overlap the bytes it is producing
+        for (; len > 0; len--, dstPos++)
+            dst[dstPos] = dst[dstPos - offset];
+    }
+
+    return dstPos;
+}
+
+/** 
+ * decompress_chunk
+ * 
+ * Description: Gathers one compressed chunk from a compressed file's stream blocks and decodes it
+ * 
+ * Inputs: zinode - inode of the compressed file
+ *         chunk - index of the 4KB chunk
+ *         dst - BLOCK_SIZE buffer for the chunk
+ * 
+ * Outputs: 0 on success, -1 for a bad inode or corrupt chunk
+ * 
+ * Side Effects: Uses zchunk_buf, callers keep interrupts off
+ */
+static int32_t decompress_chunk(const zinode_t* zinode, uint32_t chunk, uint8_t* dst) {
+    uint32_t start, size, want, pos, piece;
+    uint8_t* block;
+
+    if (zinode->numChunks > ZINODE_MAX_CHUNKS || zinode->numStreamBlocks > ZINODE_MAX_STREAM_BLOCKS || chunk >= zinode->numChunks)
+        return -1;
+    start = zinode->chunkOffsets[chunk];
+    size = zinode->chunkOffsets[chunk + 1] - start;
+    if (zinode->chunkOffsets[chunk + 1] < start || size > BLOCK_SIZE || zinode->chunkOffsets[chunk + 1] > zinode->numStreamBlocks * BLOCK_SIZE)
+        return -1;
+
+    // the chunk may straddle stream blocks that aren't next to each other
+    for (pos = 0; pos < size; pos += piece) {
+        piece = BLOCK_SIZE - (start + pos) % BLOCK_SIZE;
+        if (piece > size - pos) piece = size - pos;
+        if ((block = get_block_addr(zinode->streamBlocks[(start + pos) / BLOCK_SIZE])) == NULL || (zinode->streamBlocks[(start + pos) / BLOCK_SIZE] & OVERLAY_BLOCK_FLAG))
+            return -1;
+        memcpy(zchunk_buf + pos, block + (start + pos) % BLOCK_SIZE, piece);
+    }
+
+    want = zinode->length - chunk*BLOCK_SIZE;
+    if (want > BLOCK_SIZE) want = BLOCK_SIZE;
+
+    // chunks that don't get smaller are stored as they are
+    if (size == BLOCK_SIZE) {
+        memcpy(dst, zchunk_buf, want);
+        return 0;
+    }
+    return (lz4_decompress(zchunk_buf, size, dst, BLOCK_SIZE) == want) ? 0 : -1;
+}
+
+/** 
+ * get_zcache_chunk
+ * 
+ * Description: Finds a decompressed chunk in the cache, decompressing it into the least
+ *              recently used entry on a miss
+ * 
+ * Inputs: inode - inode number of the compressed file
+ *         zinode - its inode
+ *         chunk - index of the 4KB chunk
+ * 
+ * Outputs: Pointer to the decompressed chunk, NULL for a corrupt chunk
+ * 
+ * Side Effects: May replace a cache entry, callers keep interrupts off
+ */
+static uint8_t* get_zcache_chunk(uint32_t inode, const zinode_t* zinode, uint32_t chunk) {
+    zcache_entry_t* entry = &zcache[0];
+    uint32_t i;
+
+    for (i = 0; i < ZCACHE_ENTRIES; i++) {
+        if (zcache[i].valid && zcache[i].inode == inode && zcache[i].chunk == chunk) {
+            zcache[i].last_used = ++zcache_clock;
+            return zcache[i].data;
+        }
+        if (!zcache[i].valid || (entry->valid && zcache[i].last_used < entry->last_used))
+            entry = &zcache[i];
+    }
+
+    entry->valid = 0;
+    if (decompress_chunk(zinode, chunk, entry->data))
+        return NULL;
+    entry->valid = 1;
+    entry->inode = inode;
+    entry->chunk = chunk;
+    entry->last_used = ++zcache_clock;
+    return entry->data;
+}
+
+/** 
+ * read_compressed
+ * 
+ * Description: Copies bytes of a compressed file out of the chunks a read touches
+ * 
+ * Inputs: inode - inode number of the compressed file
+ *         zinode - its inode
+ *         offset - offset in file to begin reading from
+ *         buf - buffer to read data into
+ *         length - length of bytes to read, already clamped to the file length
+ * 
+ * Outputs: Number of bytes read on success, -1 for a corrupt chunk
+ * 
+ * Side Effects: Fills buf, with interrupts off so reads on other terminals don't share a cache entry
+ */
+static int32_t read_compressed(uint32_t inode, const zinode_t* zinode, uint32_t offset, uint8_t* buf, uint32_t length) {
+    uint32_t bytes_read, blockOffset, chunk, flags;
+    uint8_t* data;
+
+    cli_and_save(flags);
+    for (bytes_read = 0; bytes_read < length; bytes_read += chunk) {
+        blockOffset = (offset + bytes_read) % BLOCK_SIZE;
+        chunk = BLOCK_SIZE - blockOffset;
+        if (chunk > length - bytes_read) {
+            chunk = length - bytes_read;
+        }
+
+        // fault in the destination first, at most two pages for a chunk. The page fault
+        // handler reads executables through this cache and could evict the entry mid-copy
+        touch_buffer(buf + bytes_read, chunk);
+        if ((data = get_zcache_chunk(inode, zinode, (offset + bytes_read) / BLOCK_SIZE)) == NULL) {
+            restore_flags(flags);
+            return -1;
+        }
+        memcpy(buf + bytes_read, data + blockOffset, chunk);
+    }
+    restore_flags(flags);
+
+    return bytes_read;
+}
+
+/** 
+ * hash_insert_dentry
+ * 
+ * Description: Adds a dentry index to the hash index used by lookup_dentry
+ * 
+ * Inputs: index - dentry index, as given to get_dentry
+ * 
+ * Outputs: None
+ * 
+ * Side Effects: Fills a dentry_hash slot
+ */
+static void hash_insert_dentry(uint32_t index) {
+    uint32_t slot = hash_file_name(get_dentry(index)->fileName, NULL) & (DENTRY_HASH_SIZE - 1);
+    while (dentry_hash[slot])
+        slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);     // linear probing
+    dentry_hash[slot] = index + 1;
+}
+
+
+/** 
+ * build_extents
+ * 
+ * Description: Collapses the data block list of every v1 inode into runs of consecutive data blocks.
+ *              Inodes with a bad block number, or that don't fit in the tables, get no extent
+ *              list and are read one block at a time like before. v2 inodes already hold extents
+ * 
+ * Inputs: None
+ * 
+ * Outputs: None
+ * 
+ * Side Effects: Fills extents, extent_first and extent_count
+ */
+static void build_extents() {
+    uint32_t i, j, numInodes, numBlocks, used, first;
+    inode_t* cur_node;
+    extent_t* cur;
+
+    memset(extent_count, 0, sizeof(extent_count));
+    numInodes = num_module_inodes;
+    if (numInodes > MAX_EXTENT_INODES) numInodes = MAX_EXTENT_INODES;
+
+    used = 0;
+    for (i = 0; i < numInodes; i++) {
+        cur_node = (inode_t*)(inode_start + i*BLOCK_SIZE);
+        if (get_zinode(i) != NULL) continue;
+        numBlocks = (cur_node->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (numBlocks > MAX_DATA_BLOCKS) continue;
+
+        first = used;
+        for (j = 0; j < numBlocks; j++) {
+            if (cur_node->dataBlocks[j] >= num_data_blocks) break;
+
+            if (used > first) {
+                cur = &extents[used - 1];
+                if (cur->dataBlock + cur->numBlocks == cur_node->dataBlocks[j]) {
+                    cur->numBlocks++;   // continues the current run
+                    continue;
+                }
+            }
+            if (used == MAX_EXTENTS) break;
+            extents[used].fileBlock = j;
+            extents[used].numBlocks = 1;
+            extents[used].dataBlock = cur_node->dataBlocks[j];
+            used++;
+        }
+
+        // a partial list would hide the bad block from read_data, keep only complete ones
+        if (j < numBlocks) {
+            used = first;
+            continue;
+        }
+        extent_first[i] = first;
+        extent_count[i] = used - first;
+    }
+}
+
+
+/** 
+ * parse_boot_block
+ * 
+ * Description: Reads the counts in a boot block. Its first word tells a v2 filesystem from a v1 one
+ * 
+ * Inputs: boot - the boot block
+ * 
+ * Outputs: Number of directory blocks after the boot block (0 for v1), -1 for a bad boot block
+ * 
+ * Side Effects: Sets fs_version and the module counts
+ */
+static int32_t parse_boot_block(const uint32_t* boot) {
+    if (boot[0] == FS_V2_MAGIC) {
+        const bootBlockV2_t* boot_block_v2 = (const bootBlockV2_t*)boot;
+        if (boot_block_v2->version != FS_VERSION_2) return -1;
+
+        fs_version = FS_VERSION_2;
+        num_module_inodes = boot_block_v2->n;
+        num_data_blocks = boot_block_v2->d;
+        num_module_dentries = boot_block_v2->numDentries;
+        if (num_module_dentries > boot_block_v2->dirBlocks * DENTRIES_PER_BLOCK)
+            num_module_dentries = boot_block_v2->dirBlocks * DENTRIES_PER_BLOCK;
+        if (num_module_dentries > MAX_DENTRIES_V2) num_module_dentries = MAX_DENTRIES_V2;
+        return boot_block_v2->dirBlocks;
+    }
+
+    const bootBlock_t* boot_block_ptr = (const bootBlock_t*)boot;
+
+    fs_version = 1;
+    num_module_inodes = boot_block_ptr->n;
+    num_data_blocks = boot_block_ptr->d;
+    num_module_dentries = boot_block_ptr->numDentries;
+    if (num_module_dentries > MAX_DENTRIES) num_module_dentries = MAX_DENTRIES;
+    return 0;
+}
+
+/** 
+ * index_dentries
+ * 
+ * Description: Builds the dentry hash index used by lookup_dentry and marks compressed inodes
+ * 
+ * Inputs: None
+ * 
+ * Outputs: None
+ * 
+ * Side Effects: Fills dentry_hash and inode_compressed
+ */
+static void index_dentries() {
+    uint32_t i;
+
+    memset(dentry_hash, 0, sizeof(dentry_hash));
+    memset(inode_compressed, 0, sizeof(inode_compressed));
+
+    // insert in index order so the first of any duplicate names is found first, like the old linear scan
+    for (i = 0; i < num_module_dentries; i++) {
+        hash_insert_dentry(i);
+        if (module_dentries[i].fileType == FILE_COMPRESSED && module_dentries[i].inodeNum < MAX_EXTENT_INODES)
+            inode_compressed[module_dentries[i].inodeNum / 32] |= 1 << (module_dentries[i].inodeNum % 32);
+    }
+}
+
+/** 
+ * init_filesys
+ * 
+ * Description: Initialize file system: boot block and data block based on mod address
+ *              Builds the dentry hash index used by lookup_dentry
+ * 
+ * Inputs: mod - file system module from kernel.c which contains file system start
+ * 
+ * Outputs: 0 on success, -1 on failure
+ * 
+ * Side Effects: Populates file scope variables
+ */
+int32_t init_filesys(uint32_t* mod){
+    int32_t dirBlocks;
+    
+    if (mod == NULL || (dirBlocks = parse_boot_block(mod)) < 0) return -1;
+
+    fs_on_disk = 0;
+    if (fs_version == FS_VERSION_2)
+        module_dentries = (dentry_t*)((uint8_t*)mod + BLOCK_SIZE);
+    else
+        module_dentries = ((bootBlock_t*)mod)->dentries;
+    inode_start = (uint8_t*)mod + (1 + dirBlocks)*BLOCK_SIZE;
+    dataBlock_start = inode_start + num_module_inodes*BLOCK_SIZE;
+    // cur_open_file = NULL;
+
+    index_dentries();
+    if (fs_version == 1)
+        build_extents();
+
+    return 0;
+}
+
+/** 
+ * init_filesys_disk
+ * 
+ * Description: Initialize file system from the ATA disk when there is no module. Only the
+ *              boot block and directory are read here, inodes and data blocks are read
+ *              through the buffer cache when a file is used
+ * 
+ * Inputs: None
+ * 
+ * Outputs: 0 on success, -1 if there is no disk or it has no filesystem
+ * 
+ * Side Effects: Populates file scope variables, reads the directory from the disk
+ */
+int32_t init_filesys_disk() {
+    int32_t dirBlocks;
+    uint32_t i;
+
+    if (ata_init() || bcache_init(ata_num_blocks()))
+        return -1;
+    if (bcache_read(0, 0, disk_boot_block, BLOCK_SIZE) < 0 || (dirBlocks = parse_boot_block(disk_boot_block)) < 0)
+        return -1;
+
+    if (fs_version == FS_VERSION_2) {
+        // only the blocks holding the dentries the kernel indexes
+        for (i = 0; i * DENTRIES_PER_BLOCK < num_module_dentries; i++) {
+            if (bcache_read(1 + i, 0, &disk_dentries[i * DENTRIES_PER_BLOCK], BLOCK_SIZE) < 0)
+                return -1;
+        }
+        module_dentries = disk_dentries;
+    } else {
+        module_dentries = ((bootBlock_t*)disk_boot_block)->dentries;
+    }
+
+    fs_on_disk = 1;
+    inode_start = NULL;
+    dataBlock_start = NULL;
+    disk_inode_block = 1 + dirBlocks;
+    disk_data_block = disk_inode_block + num_module_inodes;
+    memset(extent_count, 0, sizeof(extent_count));
+    index_dentries();
+
+    return 0;
+}
 
 
 /** 
- * init_filesys
+ * lookup_dentry
  * 
- * Description: Initialize file system: boot block and data block based on mod address
+ * Description: Finds the dentry with name fname in the hash index built by init_filesys
  * 
- * Inputs: mod - file system module from kernel.c which contains file system start
+ * Inputs: fname - name of file to find
+ *         dentry - filled with a pointer to the dentry in the module or overlay
  * 
  * Outputs: 0 on success, -1 on failure
  * 
- * Side Effects: Populates file scope variables
+ * Side Effects: None, the returned dentry must not be modified
  */
-int32_t init_filesys(uint32_t* mod){
-    
-    if (mod == NULL) return -1;
+int32_t lookup_dentry (const uint8_t* fname, const dentry_t** dentry) {
+    uint32_t len, slot;
+    const dentry_t* cur;
 
-    boot_block_ptr = (bootBlock_t*)mod;
-    dataBlock_start = (uint8_t*)(boot_block_ptr + 1 + boot_block_ptr->n);
-    // cur_open_file = NULL;
+    if (fname == NULL || dentry == NULL) return -1;
 
-    return 0;
+    slot = hash_file_name((int8_t*)fname, &len) & (DENTRY_HASH_SIZE - 1);
+    if (len == 0 || len > MAX_FILE_NAME_LEN)
+        return -1;
+
+    // find dentry in sysmem by comparing filename, stopping at the first empty slot
+    while (dentry_hash[slot]) {
+        cur = get_dentry(dentry_hash[slot] - 1);
+        if (strncmp(cur->fileName, (int8_t*)fname, MAX_FILE_NAME_LEN) == 0) {
+            *dentry = cur;
+            return 0;
+        }
+        slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);
+    }
+    // fname not found
+    return -1;
 }
 
 
@@ -41,32 +862,17 @@ int32_t init_filesys(uint32_t* mod){
  * Side Effects: Fills dentry pointer
  */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry) {
-    int i;
+    const dentry_t* found;
 
-    if (fname == NULL || dentry == NULL){ return -1;}
-    if (strlen((int8_t*)fname) == 0 || strlen((int8_t*)fname) > MAX_FILE_NAME_LEN)
+    if (dentry == NULL || lookup_dentry(fname, &found))
         return -1;
-        
-    int8_t filename[MAX_FILE_NAME_LEN + 1];
-    strncpy((int8_t *) filename, (int8_t *) fname, MAX_FILE_NAME_LEN);
-    filename[MAX_FILE_NAME_LEN + 1] = 0x0;
-
-    // find dentry in sysmem by comparing filename
-    for (i=0; i < NUM_DENTRIES; i++) {
-        if (strncmp(boot_block_ptr->dentries[i].fileName, filename, MAX_FILE_NAME_LEN) == 0) {
-            //actually fill the struct
-            strcpy(dentry->fileName , filename);
-
-            // fileType is 32 bytes into dentry struct
-            dentry->fileType = *((uint8_t*)&boot_block_ptr->dentries[i] + 32);
-            // inode number is 36 bytes into dentry struct
-            dentry->inodeNum = *((uint8_t*)&boot_block_ptr->dentries[i] + 36);
 
-            return 0;
-        }
-    }
-    // fname not found
-    return -1;
+    //actually fill the struct
+    memcpy(dentry->fileName, found->fileName, MAX_FILE_NAME_LEN);
+    dentry->fileType = (found->fileType == FILE_COMPRESSED) ? FILE : found->fileType; // compression is not visible
+    dentry->inodeNum = found->inodeNum;
+
+    return 0;
 }
 
 /** 
@@ -82,15 +888,13 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry) {
  * Side Effects: Fills dentry pointer
  */
 int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry) {
-    // fill in dentry struct with info from index
-    if (dentry == NULL || index < 0 || index >= MAX_DENTRIES){ return -1;}
-
-    memcpy(dentry->fileName, &boot_block_ptr->dentries[index], MAX_FILE_NAME_LEN);
+    // fill in dentry struct with info from index, boot block dentries first then created files
+    const dentry_t* found = get_dentry(index);
+    if (dentry == NULL || found == NULL){ return -1;}
 
-    // fileType is 32 bytes into dentry struct
-    dentry->fileType = *((uint8_t*)&boot_block_ptr->dentries[index] + 32);
-    // inode number is 36 bytes into dentry struct
-    dentry->inodeNum = *((uint8_t*)&boot_block_ptr->dentries[index] + 36);
+    memcpy(dentry->fileName, found->fileName, MAX_FILE_NAME_LEN);
+    dentry->fileType = (found->fileType == FILE_COMPRESSED) ? FILE : found->fileType; // compression is not visible
+    dentry->inodeNum = found->inodeNum;
 
     return 0;
 }
@@ -106,61 +910,361 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry) {
  *         buf - buffer to read data into
  *         length - length of bytes to read
  * 
- * Outputs: 0 on success, -1 on failure
+ * Outputs: Number of bytes read (0 at end of file) on success, -1 on failure
  * 
- * Side Effects: Fills dentry pointer
+ * Side Effects: Fills buf using one memcpy per extent touched
  */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
-    // copy char data from filesys into the buf
+    // copy char data from filesys into the buf, one span per run of consecutive data blocks
     
     // can't check that inode actually corresponds to file
-    if ( inode < 0 || inode > MAX_DENTRIES || offset < 0 || buf == NULL ) {
+    int32_t file_len = get_file_len_by_inode(inode);
+    if (file_len < 0 || buf == NULL) {
         return -1;
     }
 
-    //init some offsets, position vars
-    int i;
-    int tmp_offset = offset;
-    int32_t bytes_read = 0;
-    uint32_t position;
-    inode_t* cur_node = (inode_t*) (boot_block_ptr + inode + 1); // start of filesys + inode# + 1 for the bootblock
-    // uint32_t fileLength = ((inode_t*)(boot_block_ptr + inode + 1))->length;
+    uint32_t blockIdx, blockOffset, chunk;
+    int32_t bytes_read, run;
+    uint8_t* run_addr;
+    zinode_t* zinode;
+
+    // clamp to the file length once, reads at or past the end return 0 bytes
+    if (offset >= file_len) {
+        return 0;
+    }
+    if (length > file_len - offset) {
+        length = file_len - offset;
+    }
 
-    uint32_t blockIdx = 0;
-    uint32_t curDataBlockIdx = cur_node->dataBlocks[blockIdx];
+    // compressed files have no data blocks to copy from, only the chunks the read touches are decompressed
+    if ((zinode = get_zinode(inode)) != NULL) {
+        return read_compressed(inode, zinode, offset, buf, length);
+    }
 
-    // if offset >= Block size need to start at the proper Block, used for multiple reads of same file
-    if (tmp_offset >= BLOCK_SIZE) {
-        curDataBlockIdx = cur_node->dataBlocks[tmp_offset / BLOCK_SIZE];
-        tmp_offset = tmp_offset % BLOCK_SIZE;
+    // files on the disk are copied out of the buffer cache
+    if (is_disk_inode(inode)) {
+        return read_disk_data(inode, offset, buf, length, file_len);
     }
 
-    // looping through length bytes of the file
-    for (i = 0, position = 0; i < length; i++, position++) {
-        if (bytes_read >= cur_node->length || (offset + position) >= cur_node->length) {
-            return bytes_read;
+    // start at the proper block if offset >= Block size, used for multiple reads of same file
+    blockIdx = offset / BLOCK_SIZE;
+    blockOffset = offset % BLOCK_SIZE;
+
+    for (bytes_read = 0; bytes_read < length; bytes_read += chunk) {
+        // if bad data block number is found within file bounds of inode, return -1
+        run = get_file_extent(inode, blockIdx, &run_addr);
+        if (run <= 0) {
+            return -1;
+        }
+
+        // copy the rest of this run, or what is left of the read if that is smaller
+        chunk = run * BLOCK_SIZE - blockOffset;
+        if (chunk > length - bytes_read) {
+            chunk = length - bytes_read;
         }
+        memcpy(buf + bytes_read, run_addr + blockOffset, chunk);
+        blockIdx += run;
+        blockOffset = 0;
+    }
 
-        // update block if weve reached the end of one
-        if (position + tmp_offset >= BLOCK_SIZE) {
-            blockIdx++;
-            curDataBlockIdx = cur_node->dataBlocks[blockIdx];
-            tmp_offset = 0;
-            position = 0;
+    return bytes_read;
+}
 
-            // if bad data block number is found within file bounds of inode, return -1
-            // check for bad block number
-            if (curDataBlockIdx == NULL || blockIdx > MAX_DATA_BLOCKS) {
-                return -1;
+/** 
+ * cow_inode
+ * 
+ * Description: Returns the writable overlay copy of an inode, copying the module's block list
+ *              on the first write. Compressed files and files on the disk have no block list
+ *              in memory and are copied into overlay blocks in full instead.
+ *              The file loses its extent list and cached exec image.
+ *              v2 files over MAX_FILE_LEN have too many blocks for an overlay inode and stay read only
+ * 
+ * Inputs: inode - inode number
+ * 
+ * Outputs: Pointer to the overlay inode, NULL for a bad inode number or a full overlay
+ * 
+ * Side Effects: May take an overlay inode
+ */
+static inode_t* cow_inode(uint32_t inode) {
+    inode_t* cur_node;
+    int32_t length, run, i;
+    uint32_t blockIdx, numBlocks;
+    uint8_t* addr;
+    zinode_t* zinode;
+    int32_t disk = 0;
+
+    if (inode >= MAX_EXTENT_INODES)
+        return NULL;
+    if (overlay_inode_idx[inode])
+        return &overlay_inodes[overlay_inode_idx[inode] - 1];
+    if (inode >= num_module_inodes || num_overlay_inodes == OVERLAY_INODES)
+        return NULL;
+    if ((length = get_file_len_by_inode(inode)) < 0 || length > MAX_FILE_LEN)
+        return NULL;
+
+    cur_node = &overlay_inodes[num_overlay_inodes];
+    numBlocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    // a compressed file is decompressed into overlay blocks in full, a file on the disk read in full
+    if ((zinode = get_zinode(inode)) != NULL || (disk = is_disk_inode(inode))) {
+        for (blockIdx = 0; blockIdx < numBlocks; blockIdx++) {
+            if ((cur_node->dataBlocks[blockIdx] = alloc_overlay_block()) == 0 ||
+                (zinode != NULL && decompress_chunk(zinode, blockIdx, get_block_addr(cur_node->dataBlocks[blockIdx]))) ||
+                (disk && read_data(inode, blockIdx * BLOCK_SIZE, get_block_addr(cur_node->dataBlocks[blockIdx]), BLOCK_SIZE) < 0)) {
+                for (i = 0; i <= blockIdx; i++) {
+                    if (cur_node->dataBlocks[i]) free_overlay_block(cur_node->dataBlocks[i]);
+                }
+                return NULL;
             }
         }
+    }
+    // otherwise rebuild the block list from the extents, so v1 and v2 inodes copy the same way
+    for (blockIdx = 0; zinode == NULL && !disk && blockIdx < numBlocks; blockIdx += run) {
+        if ((run = get_file_extent(inode, blockIdx, &addr)) <= 0)
+            return NULL;
+        for (i = 0; i < run; i++)
+            cur_node->dataBlocks[blockIdx + i] = (addr - dataBlock_start) / BLOCK_SIZE + i;
+    }
+    cur_node->length = length;
+    overlay_inode_idx[inode] = ++num_overlay_inodes;
+    extent_count[inode] = 0;
+    exec_cache_invalidate(inode);
+
+    return cur_node;
+}
+
+/** 
+ * cow_block
+ * 
+ * Description: Returns a writable data block of an overlay inode. A module block is copied
+ *              into the overlay on first write, a block past the end of the file is added zeroed
+ * 
+ * Inputs: cur_node - overlay inode
+ *         blockIdx - index of the block within the file, at most one past its last block
+ * 
+ * Outputs: Pointer to the 4KB data block, NULL for a bad block number or a full overlay
+ * 
+ * Side Effects: May take an overlay block
+ */
+static uint8_t* cow_block(inode_t* cur_node, uint32_t blockIdx) {
+    uint32_t blockNum;
+    uint8_t* old_block;
+
+    if (blockIdx >= MAX_DATA_BLOCKS)
+        return NULL;
+
+    if (blockIdx < (cur_node->length + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+        if (cur_node->dataBlocks[blockIdx] & OVERLAY_BLOCK_FLAG)
+            return get_block_addr(cur_node->dataBlocks[blockIdx]);
+        if ((old_block = get_block_addr(cur_node->dataBlocks[blockIdx])) == NULL)
+            return NULL;
+    } else {
+        old_block = NULL;
+    }
+
+    if ((blockNum = alloc_overlay_block()) == 0)
+        return NULL;
+    if (old_block != NULL)
+        memcpy(get_block_addr(blockNum), old_block, BLOCK_SIZE);
+    cur_node->dataBlocks[blockIdx] = blockNum;
+
+    return get_block_addr(blockNum);
+}
+
+/** 
+ * write_data
+ * 
+ * Description: Writes "length" bytes from buf to file "inode" starting at "offset" bytes.
+ *              Module blocks are copied into the overlay the first time they are written,
+ *              the file grows if the write goes past its end
+ * 
+ * Inputs: inode - inode number
+ *         offset - offset in file to begin writing at, a gap past the end is zero filled
+ *         buf - data to write
+ *         length - length of bytes to write
+ * 
+ * Outputs: Number of bytes written, less than length if the overlay filled up, -1 on failure
+ * 
+ * Side Effects: Changes the overlay, with interrupts off so writers on other terminals don't interleave
+ */
+int32_t write_data (uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length) {
+    uint32_t pos, end, blockOffset, chunk, flags;
+    inode_t* cur_node;
+    uint8_t* block;
+
+    if (buf == NULL || offset > MAX_FILE_LEN)
+        return -1;
+    if (length > MAX_FILE_LEN - offset)
+        length = MAX_FILE_LEN - offset;
+    if (length == 0)
+        return 0;
+
+    cli_and_save(flags);
+    if ((cur_node = cow_inode(inode)) == NULL) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    // start at the old end of the file if the write leaves a gap, so the gap reads as zeros
+    pos = (offset < cur_node->length) ? offset : cur_node->length;
+    end = offset + length;
+    while (pos < end) {
+        blockOffset = pos % BLOCK_SIZE;
+        if ((block = cow_block(cur_node, pos / BLOCK_SIZE)) == NULL)
+            break;
+
+        chunk = BLOCK_SIZE - blockOffset;
+        if (pos < offset) {
+            if (chunk > offset - pos) chunk = offset - pos;
+            memset(block + blockOffset, 0, chunk);
+        } else {
+            if (chunk > end - pos) chunk = end - pos;
+            memcpy(block + blockOffset, buf + (pos - offset), chunk);
+        }
+        pos += chunk;
+        if (pos > cur_node->length)
+            cur_node->length = pos;
+    }
+    restore_flags(flags);
+
+    return (pos > offset) ? pos - offset : -1;
+}
+
+/** 
+ * create_file
+ * 
+ * Description: Creates an empty regular file with a new overlay dentry and inode
+ * 
+ * Inputs: fname - name of the file, not NULL terminated
+ *         len - length of the name, 1 to MAX_FILE_NAME_LEN
+ * 
+ * Outputs: 0 on success, -1 if the name is bad or taken or the overlay is full
+ * 
+ * Side Effects: Adds the dentry to the hash index and directory listing
+ */
+int32_t create_file (const uint8_t* fname, uint32_t len) {
+    uint8_t name[MAX_FILE_NAME_LEN + 1];
+    const dentry_t* found;
+    dentry_t* new_dentry;
+    uint32_t inode, i, flags;
 
-        // copy a byte from the file into the buffer
-        buf[i] = *((uint8_t*) (dataBlock_start + curDataBlockIdx*BLOCK_SIZE + tmp_offset + position));
-        bytes_read++;
+    if (fname == NULL || len == 0 || len > MAX_FILE_NAME_LEN)
+        return -1;
+    memcpy(name, fname, len);
+    name[len] = NULL;
+    for (i = 0; i < len; i++) {
+        if (name[i] == NULL) return -1;
     }
 
-    return bytes_read;
+    cli_and_save(flags);
+    inode = num_module_inodes + num_overlay_inodes;     // past every module inode and created inode
+    if (lookup_dentry(name, &found) == 0 || num_overlay_dentries == OVERLAY_DENTRIES ||
+        num_overlay_inodes == OVERLAY_INODES || inode >= MAX_EXTENT_INODES) {
+        restore_flags(flags);
+        return -1;
+    }
+
+    overlay_inodes[num_overlay_inodes].length = 0;    // no blocks until the first write
+    overlay_inode_idx[inode] = ++num_overlay_inodes;
+
+    new_dentry = &overlay_dentries[num_overlay_dentries++];
+    memset(new_dentry, 0, sizeof(dentry_t));
+    memcpy(new_dentry->fileName, name, len);
+    new_dentry->fileType = FILE;
+    new_dentry->inodeNum = inode;
+    hash_insert_dentry(num_module_dentries + num_overlay_dentries - 1);
+    restore_flags(flags);
+
+    return 0;
+}
+
+/** 
+ * get_file_extent
+ * 
+ * Description: Finds the run of consecutive data blocks holding the blockIdx'th block of a file,
+ *              from a v2 inode's extents, the extent list built by init_filesys for a v1 inode,
+ *              or the inode's block list without one
+ * 
+ * Inputs: inode - inode number
+ *         blockIdx - index of the block within the file
+ *         addr - filled with the address of the blockIdx'th data block
+ * 
+ * Outputs: Number of contiguous blocks from blockIdx on, 0 if blockIdx is past the end of
+ *          the file, -1 for a bad inode or data block number
+ * 
+ * Side Effects: None
+ */
+int32_t get_file_extent(uint32_t inode, uint32_t blockIdx, uint8_t** addr) {
+    uint32_t numBlocks, dataBlock, run;
+    inodeV2_t* v2_node;
+    inode_t* cur_node;
+    extent_t* cur;
+
+    int32_t file_len = get_file_len_by_inode(inode);
+    if (file_len < 0 || addr == NULL) {
+        return -1;
+    }
+
+    numBlocks = ((uint32_t)file_len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (blockIdx >= numBlocks) {
+        return 0;
+    }
+
+    // compressed files and files on the disk have no data blocks in memory to point at
+    if (get_zinode(inode) != NULL || is_disk_inode(inode)) {
+        return -1;
+    }
+
+    if ((v2_node = get_inode_v2(inode)) != NULL) {
+        cur = find_extent(v2_node->extents, (v2_node->numExtents < V2_INODE_EXTENTS) ? v2_node->numExtents : V2_INODE_EXTENTS, blockIdx);
+    } else if (inode < MAX_EXTENT_INODES && extent_count[inode]) {
+        // written files lose their extent list and take the per block path below
+        cur = find_extent(&extents[extent_first[inode]], extent_count[inode], blockIdx);
+    } else {
+        cur_node = get_inode(inode);
+        if (blockIdx >= MAX_DATA_BLOCKS || (*addr = get_block_addr(cur_node->dataBlocks[blockIdx])) == NULL) {
+            return -1;
+        }
+        return 1;
+    }
+
+    // a hole in the extents or a run off the end of the data blocks is a bad file
+    if (cur == NULL) {
+        return -1;
+    }
+    dataBlock = cur->dataBlock + (blockIdx - cur->fileBlock);
+    run = cur->numBlocks - (blockIdx - cur->fileBlock);
+    if (dataBlock >= num_data_blocks || run > num_data_blocks - dataBlock) {
+        return -1;
+    }
+    if (run > numBlocks - blockIdx) {
+        run = numBlocks - blockIdx;
+    }
+
+    *addr = dataBlock_start + dataBlock*BLOCK_SIZE;
+    return run;
+}
+
+/** 
+ * get_data_block_addr
+ * 
+ * Description: Returns the address of the blockIdx'th data block of a file
+ * 
+ * Inputs: inode - inode number
+ *         blockIdx - index of the block within the file
+ * 
+ * Outputs: Pointer to the 4KB data block, NULL if blockIdx is past the end of the file
+ * 
+ * Side Effects: None
+ */
+uint8_t* get_data_block_addr(uint32_t inode, uint32_t blockIdx) {
+    uint8_t* addr;
+
+    if (get_file_extent(inode, blockIdx, &addr) <= 0) {
+        return NULL;
+    }
+
+    return addr;
 }
 
 /** 
@@ -177,7 +1281,7 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
 int32_t getFileLen(int32_t fd){
     pcb_t* pcb = getPCB();
 
-    return ((inode_t*)(boot_block_ptr + pcb->fda[fd].inode + 1))->length;
+    return get_file_len_by_inode(pcb->fda[fd].inode);
 }
 
 /** 
@@ -192,7 +1296,72 @@ int32_t getFileLen(int32_t fd){
  * Side Effects: None
  */
 int32_t get_file_len_by_dentry(dentry_t dentry){
-    return ((inode_t*)(boot_block_ptr + dentry.inodeNum + 1))->length;
+    return get_file_len_by_inode(dentry.inodeNum);
+}
+
+/** 
+ * get_file_len_by_inode
+ * 
+ * Description: Returns file length of file with the given inode
+ * 
+ * Inputs: inode - inode number
+ * 
+ * Outputs: Length of file in bytes, -1 for a bad inode number
+ * 
+ * Side Effects: None
+ */
+int32_t get_file_len_by_inode(uint32_t inode){
+    if (is_disk_inode(inode)) {
+        return get_disk_file_len(inode);
+    }
+
+    zinode_t* zinode = get_zinode(inode);
+    if (zinode != NULL) {
+        return (zinode->length > MAX_FILE_POS) ? MAX_FILE_POS : zinode->length;
+    }
+
+    inodeV2_t* v2_node = get_inode_v2(inode);
+    if (v2_node != NULL) {
+        // the 64 bit length is clamped to what an int32_t can report
+        if (v2_node->lengthHigh || v2_node->length > MAX_FILE_POS) return MAX_FILE_POS;
+        return v2_node->length;
+    }
+
+    inode_t* cur_node = get_inode(inode);
+    if (cur_node == NULL) return -1;
+
+    return cur_node->length;
+}
+
+/** 
+ * stat_by_inode
+ * 
+ * Description: Fills buf with what the inode and dentry say about a file, without reading its data
+ * 
+ * Inputs: type - file type from the dentry
+ *         inode - inode number from the dentry
+ *         buf - stat_t to fill
+ * 
+ * Outputs: 0 on success, -1 for a regular file with a bad inode number
+ * 
+ * Side Effects: None
+ */
+int32_t stat_by_inode(int32_t type, uint32_t inode, stat_t* buf) {
+    int32_t length = 0;
+
+    if (buf == NULL) return -1;
+    if (type == FILE_COMPRESSED) type = FILE;   // compression is not visible
+
+    // only regular files have data, the inode number of rtc and directory dentries means nothing
+    if (type == FILE && (length = get_file_len_by_inode(inode)) < 0)
+        return -1;
+
+    buf->inodeNum = inode;
+    buf->fileSize = length;
+    buf->fileType = type;
+    buf->numBlocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    return 0;
 }
 
 /** 
@@ -204,20 +1373,39 @@ int32_t get_file_len_by_dentry(dentry_t dentry){
  * 
  * Outputs: 0 on success, -1 on failure
  * 
- * Side Effects: Calls read_dentry_by_name
- *               resets offset to 0
- *               allocates new dentry struct
+ * Side Effects: Calls lookup_dentry and file_open_by_dentry
  */
 int32_t file_open (int32_t fd, const uint8_t* filename) {
 
+	const dentry_t* file;
+	if (lookup_dentry(filename, &file))				// check if file exists
+		return -1;
+
+    return file_open_by_dentry(fd, file);
+
+}
+
+/** 
+ * file_open_by_dentry
+ * 
+ * Description: opens file described by an already resolved dentry
+ * 
+ * Inputs: fd - fda index to fill
+ *         dentry - dentry of file to open
+ * 
+ * Outputs: 0 on success, -1 on failure
+ * 
+ * Side Effects: resets offset to 0
+ */
+int32_t file_open_by_dentry (int32_t fd, const dentry_t* dentry) {
+
 	pcb_t* pcb = getPCB();			// calculate current process pcb
 
-	dentry_t file;
-	if (read_dentry_by_name(filename, &file))				// check if file exists
-		return -1;
+    if (dentry == NULL)
+        return -1;
 
     pcb->fda[fd].fops = (uint32_t *) file_fops;             // open file and place into fda array
-    pcb->fda[fd].inode = file.inodeNum;
+    pcb->fda[fd].inode = dentry->inodeNum;
     pcb->fda[fd].file_position = 0;
     pcb->fda[fd].flags = 1;
 
@@ -262,10 +1450,7 @@ int32_t file_read (int32_t fd, void* buf, int32_t nbytes) {
 
     pcb_t* pcb = getPCB();
 
-    if (getFileLen(fd) < nbytes) {
-        nbytes = getFileLen(fd);
-    }
-
+    // read_data clamps nbytes to what is left of the file
     int32_t bytes_read = read_data (pcb->fda[fd].inode, pcb->fda[fd].file_position, buf, nbytes);
 
     if (bytes_read != -1) {
@@ -278,18 +1463,86 @@ int32_t file_read (int32_t fd, void* buf, int32_t nbytes) {
 /** 
  * file_write
  * 
- * Description: Currently does nothing
+ * Description: Writes nbytes from buf to fd
  * 
  * Inputs: fd - file to write
- *         buf - buffer to write data into
+ *         buf - buffer to write data from
  *         nbytes - number of bytes to write
  * 
- * Outputs: -1
+ * Outputs: Number of bytes written on success, -1 on failure
  * 
- * Side Effects: None
+ * Side Effects: Calls write_data
+ *               Increments offset by number of bytes written
  */
 int32_t file_write (int32_t fd, const void* buf, int32_t nbytes){
-    return -1;
+    if (buf == NULL || nbytes < 0) return -1;
+
+    pcb_t* pcb = getPCB();
+
+    int32_t bytes_written = write_data (pcb->fda[fd].inode, pcb->fda[fd].file_position, buf, nbytes);
+
+    if (bytes_written != -1) {
+        pcb->fda[fd].file_position += bytes_written;
+    }
+
+    return bytes_written;
+}
+
+/** 
+ * file_lseek
+ * 
+ * Description: Moves the position the next read or write of fd starts at
+ * 
+ * Inputs: fd - file to seek
+ *         offset - bytes to move by, relative to whence
+ *         whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * 
+ * Outputs: New position on success, -1 for a bad whence or a position outside 0 to MAX_FILE_POS
+ * 
+ * Side Effects: Sets offset. A position past the end is allowed, a write there zero fills the gap
+ */
+int32_t file_lseek (int32_t fd, int32_t offset, int32_t whence) {
+    pcb_t* pcb = getPCB();
+    int32_t base;
+
+    if (whence == SEEK_SET) {
+        base = 0;
+    } else if (whence == SEEK_CUR) {
+        base = pcb->fda[fd].file_position;
+    } else if (whence == SEEK_END) {
+        if ((base = get_file_len_by_inode(pcb->fda[fd].inode)) < 0) return -1;
+    } else {
+        return -1;
+    }
+
+    // checked as a distance from base so base + offset can't overflow
+    if (offset < -base || offset > MAX_FILE_POS - base)
+        return -1;
+
+    pcb->fda[fd].file_position = base + offset;
+    return base + offset;
+}
+
+/** 
+ * file_pread
+ * 
+ * Description: Reads nbytes from fd starting at offset, straight from read_data
+ * 
+ * Inputs: fd - file to read
+ *         buf - buffer to read data into
+ *         nbytes - number of bytes to read
+ *         offset - offset in file to begin reading from
+ * 
+ * Outputs: Number of bytes read (0 at or past end of file) on success, -1 on failure
+ * 
+ * Side Effects: None, offset of fd is unchanged
+ */
+int32_t file_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset) {
+    if (buf == NULL || nbytes < 0 || offset < 0) return -1;
+
+    pcb_t* pcb = getPCB();
+
+    return read_data (pcb->fda[fd].inode, offset, buf, nbytes);
 }
 
 /** 
@@ -355,7 +1608,7 @@ int32_t dir_read (int32_t fd, void* buf, int32_t nbytes) {
 
     int fileNameBytesRead;
 
-    if (pcb->fda[fd].file_position >= boot_block_ptr->numDentries) return 0;
+    if (pcb->fda[fd].file_position >= num_module_dentries + num_overlay_dentries) return 0;
 
     char* cbuf = (char*)buf;
     dentry_t curDentry;
@@ -390,16 +1643,57 @@ int32_t dir_read (int32_t fd, void* buf, int32_t nbytes) {
 /** 
  * dir_write
  * 
- * Description: Currently does nothing
+ * Description: Creates an empty file named by the first nbytes of buf
  * 
  * Inputs: fd - dir to write
- *         buf - buffer to write data into
- *         nbytes - number of bytes to write
+ *         buf - name of the new file, not NULL terminated
+ *         nbytes - length of the name
  * 
- * Outputs: -1
+ * Outputs: nbytes on success, -1 on failure
  * 
- * Side Effects: None
+ * Side Effects: Calls create_file
  */
 int32_t dir_write (int32_t fd, const void* buf, int32_t nbytes) {
-    return -1;
+    if (nbytes <= 0 || create_file(buf, nbytes))
+        return -1;
+
+    return nbytes;
+}
+
+/** 
+ * dir_getdents
+ * 
+ * Description: Reads as many directory entries as fit in buf, continuing from where the last
+ *              dir_read or dir_getdents on fd stopped, so a whole directory takes one call
+ * 
+ * Inputs: fd - open directory
+ *         buf - filled with dirent_t records
+ *         nbytes - size of buf
+ * 
+ * Outputs: Number of bytes filled, a multiple of sizeof(dirent_t), 0 at end of directory,
+ *          -1 if buf can't hold one record
+ * 
+ * Side Effects: Advances the directory position by the number of records read
+ */
+int32_t dir_getdents (int32_t fd, void* buf, int32_t nbytes) {
+    pcb_t* pcb = getPCB();			// calculate current process pcb
+    dirent_t* out = (dirent_t*)buf;
+    const dentry_t* cur;
+    int32_t count;
+
+    if (buf == NULL || nbytes < (int32_t)sizeof(dirent_t))
+        return -1;
+
+    for (count = 0; count < nbytes / sizeof(dirent_t); count++) {
+        if ((cur = get_dentry(pcb->fda[fd].file_position)) == NULL)
+            break;
+
+        out[count].inodeNum = cur->inodeNum;
+        out[count].fileType = (cur->fileType == FILE_COMPRESSED) ? FILE : cur->fileType; // compression is not visible
+        out[count].fileSize = IS_REGULAR_FILE(cur->fileType) ? get_file_len_by_inode(cur->inodeNum) : 0;
+        memcpy(out[count].fileName, cur->fileName, MAX_FILE_NAME_LEN);
+        pcb->fda[fd].file_position++;
+    }
+
+    return count * sizeof(dirent_t);
 }
@@ -15,7 +15,33 @@
 #define DENTRY_SIZE             64
 #define NUM_DENTRIES            64
 #define MAX_FILE_NAME_LEN       32
+#define DENTRY_HASH_SIZE        2048 // power of 2, at least twice MAX_DENTRIES_V2 + OVERLAY_DENTRIES
+#define MAX_EXTENT_INODES       1024 // inodes past this are read block by block
+#define MAX_EXTENTS             4096 // runs of consecutive data blocks over all files
+#define OVERLAY_DENTRIES        16   // files created after boot
+#define OVERLAY_INODES          32   // copied or created inodes, for written and new files
+#define OVERLAY_BLOCKS          256  // 1MB of written data blocks
+#define OVERLAY_BLOCK_FLAG      0x80000000 // set in a data block number that indexes overlay_blocks
+#define MAX_FILE_LEN            (MAX_DATA_BLOCKS * BLOCK_SIZE) // largest file the overlay can write
+#define MAX_FILE_POS            0x7FFFFFFF // largest length or position an int32_t can report
+#define FS_V2_MAGIC             0x32465346 // "FSF2", v1 has numDentries (at most 63) in this word
+#define FS_VERSION_2            2
+#define DENTRIES_PER_BLOCK      (BLOCK_SIZE / DENTRY_SIZE)
+#define MAX_DENTRIES_V2         1024 // v2 directory entries indexed by the kernel
+#define V2_INODE_EXTENTS        340  // extents that fit in a v2 inode after its 16B header
+#define INODE_V2_NUM_EXTENTS    8    // byte offset of numExtents in inodeV2_t
+#define INODE_V2_EXTENTS        16   // byte offset of extents in inodeV2_t
+#define DISK_RUN_BATCH          64   // block numbers read per lookup in a v1 inode on the disk
+#define SEEK_SET                0    // lseek whence: from the start of the file
+#define SEEK_CUR                1    // from the current position
+#define SEEK_END                2    // from the end of the file
+#define RTC                     0
 #define DIR                     1
+#define FILE_COMPRESSED         3    // regular file stored as LZ4 chunks, reported to users as FILE
+#define IS_REGULAR_FILE(type)   ((type) == FILE || (type) == FILE_COMPRESSED)
+#define ZINODE_MAX_CHUNKS       512  // 4KB chunks in a compressed file, so at most 2MB uncompressed
+#define ZINODE_MAX_STREAM_BLOCKS 508 // data blocks holding the compressed chunks
+#define ZCACHE_ENTRIES          8    // decompressed chunks kept for reads
 #define FILE                    2
 
 
@@ -41,10 +67,77 @@ typedef struct inode_t {
     uint32_t dataBlocks[MAX_DATA_BLOCKS]; // in B, max 1023 data block nums
 } inode_t;
 
+// run of consecutive data blocks backing consecutive blocks of a file, also the v2 on disk format
+typedef struct extent_t {
+    uint32_t fileBlock; // first block index within the file
+    uint32_t numBlocks; // length of the run
+    uint32_t dataBlock; // first data block number
+} extent_t;
+
+/*
+ * Format v2 layout, one 4KB block each unless noted:
+ *   boot block | dirBlocks blocks of 64B dentries | n inodes | d data blocks
+ * Dentries are the same as v1. Inodes hold a 64 bit length and a sorted extent list
+ * instead of 1023 block numbers, so neither the file count nor file size is capped
+ * by the boot block or inode size.
+ */
+typedef struct bootBlockV2_t {
+    uint32_t magic; // FS_V2_MAGIC
+    uint32_t version; // FS_VERSION_2
+    uint32_t numDentries;
+    uint32_t n; // num inodes
+    uint32_t d; // num data blocks
+    uint32_t dirBlocks; // num blocks of dentries following the boot block
+    uint8_t reserved[BLOCK_SIZE - 24];
+} bootBlockV2_t;
+
+/*
+ * Inode of a FILE_COMPRESSED file, same in v1 and v2. Chunk i is the i'th 4KB of the file,
+ * LZ4 block compressed into stream bytes chunkOffsets[i] to chunkOffsets[i + 1]. A chunk
+ * BLOCK_SIZE bytes long is stored uncompressed. The stream fills streamBlocks in order
+ */
+typedef struct zinode_t {
+    uint32_t length; // in B, uncompressed
+    uint32_t numChunks;
+    uint32_t numStreamBlocks;
+    uint32_t chunkOffsets[ZINODE_MAX_CHUNKS + 1];
+    uint32_t streamBlocks[ZINODE_MAX_STREAM_BLOCKS];
+} zinode_t;
+
+typedef struct inodeV2_t {
+    uint32_t length; // in B, low 32 bits
+    uint32_t lengthHigh; // in B, high 32 bits
+    uint32_t numExtents;
+    uint32_t reserved;
+    extent_t extents[V2_INODE_EXTENTS]; // sorted by fileBlock
+} inodeV2_t;
+
+// directory listing record filled by getdents, packed back to back in the user buffer
+typedef struct dirent_t {
+    uint32_t inodeNum;
+    uint32_t fileSize; // in B, 0 for anything but a regular file
+    int32_t fileType;
+    int8_t fileName[MAX_FILE_NAME_LEN]; // NULL padded, not terminated if 32 chars long
+} dirent_t;
+
+// file information filled by stat and fstat
+typedef struct stat_t {
+    uint32_t inodeNum;
+    uint32_t fileSize; // in B, 0 for anything but a regular file
+    int32_t fileType;
+    uint32_t numBlocks; // 4KB data blocks holding the file
+} stat_t;
+
 
 // Initialize file system: boot block and data block based on mod address
 int32_t init_filesys(uint32_t* mod);
 
+// Initialize file system from the ATA disk, read through the buffer cache
+int32_t init_filesys_disk();
+
+// Finds the dentry with name fname through the hash index and points dentry at it
+int32_t lookup_dentry (const uint8_t* fname, const dentry_t** dentry);
+
 // Finds the dentry with name fname and fills dentry pointer with its information
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
 
@@ -54,26 +147,53 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 // Fills the given buffer with "length" bytes from file pointed to from "inode" starting at "offset" bytes
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 
+// Writes "length" bytes from buf to file "inode" at "offset", copying module blocks on first write
+int32_t write_data (uint32_t inode, uint32_t offset, const uint8_t* buf, uint32_t length);
+
+// Creates an empty regular file in the overlay; return 0 on success, -1 on failure
+int32_t create_file (const uint8_t* fname, uint32_t len);
+
+// Returns the number of contiguous data blocks from the blockIdx'th block of a file and their address
+int32_t get_file_extent(uint32_t inode, uint32_t blockIdx, uint8_t** addr);
+
+// Returns the address of the blockIdx'th data block of a file, NULL if past its end
+uint8_t* get_data_block_addr(uint32_t inode, uint32_t blockIdx);
+
 // Returns the length in bytes of the currently opened file
 int32_t getFileLen(int32_t fd);
 
 // Returns file length of file pointed to by dentry
 int32_t get_file_len_by_dentry(dentry_t dentry);
 
+// Returns file length of file with the given inode
+int32_t get_file_len_by_inode(uint32_t inode);
+
+// Fills buf with the type, size and block count of a file
+int32_t stat_by_inode(int32_t type, uint32_t inode, stat_t* buf);
+
 
 
 // opens file with given filename; return 0 on success, -1 on failure
 extern int32_t file_open (int32_t fd, const uint8_t* filename);
 
+// opens file described by an already resolved dentry; return 0 on success, -1 on failure
+int32_t file_open_by_dentry (int32_t fd, const dentry_t* dentry);
+
 // closes file; return 0 on success, -1 on failure
 extern int32_t file_close (int32_t fd);
 
 // Reads nbytes from fd into buf; returns number of bytes read
 extern int32_t file_read (int32_t fd, void* buf, int32_t nbytes);
 
-// Currently does nothing; return -1
+// Writes nbytes from buf to fd; returns number of bytes written
 extern int32_t file_write (int32_t fd, const void* buf, int32_t nbytes);
 
+// Moves the position of fd; returns the new position
+int32_t file_lseek (int32_t fd, int32_t offset, int32_t whence);
+
+// Reads nbytes from fd at offset without moving its position; returns number of bytes read
+int32_t file_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset);
+
 
 // opens directory with given dirname; return 0 on success, -1 on failure
 extern int32_t dir_open (int fd, const uint8_t* dirname);
@@ -84,9 +204,12 @@ extern int32_t dir_close (int32_t fd);
 // Reads a filename from directory into buf; return 0 on success, -1 on failure
 extern int32_t dir_read (int32_t fd, void* buf, int32_t nbytes);
 
-// Currently does nothing; return -1
+// Creates a file named by the nbytes in buf; returns nbytes on success, -1 on failure
 extern int32_t dir_write (int32_t fd, const void* buf, int32_t nbytes);
 
+// Fills buf with as many dirent_t records as fit; returns bytes filled, 0 at end of directory
+int32_t dir_getdents (int32_t fd, void* buf, int32_t nbytes);
+
 
 #endif /* _FILESYS_H */
 
@@ -0,0 +1,268 @@
+#include "frame.h"
+
+#define BITS_PER_WORD       32
+#define FULL_WORD           0xFFFFFFFF
+#define FRAME_SHIFT         12          // 4KB frame number of an address
+
+static uint32_t frame_bitmap[MAX_FRAMES / BITS_PER_WORD];   /* 1 for allocated or reserved frames */
+static uint32_t num_frames;     /* frames below the end of the highest usable region */
+static uint32_t next_frame;     /* alloc_frame starts looking here */
+static frame_stats_t frame_stats;
+
+extern uint8_t _end[];          /* end of the kernel's bss, from the linker */
+
+/**
+ * mark_frames
+ *
+ * Description: Sets or clears the bitmap bits of a run of frames, keeping the free count
+ * Inputs: first - first frame number
+ *         count - frames in the run, cut off at MAX_FRAMES
+ *         used - 1 to allocate or reserve, 0 to free
+ * Outputs: none
+ * Side Effects: Changes frame_bitmap and frame_stats.free
+ */
+static void mark_frames(uint32_t first, uint32_t count, int32_t used) {
+    uint32_t i, bit;
+
+    if (first >= MAX_FRAMES)
+        return;
+    if (count > MAX_FRAMES - first)
+        count = MAX_FRAMES - first;
+
+    for (i = first; i < first + count; i++) {
+        bit = 1 << (i % BITS_PER_WORD);
+        if (used && !(frame_bitmap[i / BITS_PER_WORD] & bit)) {
+            frame_bitmap[i / BITS_PER_WORD] |= bit;
+            frame_stats.free--;
+        } else if (!used && (frame_bitmap[i / BITS_PER_WORD] & bit)) {
+            frame_bitmap[i / BITS_PER_WORD] &= ~bit;
+            frame_stats.free++;
+        }
+    }
+}
+
+/**
+ * add_usable_range
+ *
+ * Description: Frees the whole frames inside a range of usable RAM
+ * Inputs: base - first byte of the range
+ *         length_low, length_high - bytes in the range, memory above 4GB is dropped
+ * Outputs: none
+ * Side Effects: Frees frames, raises num_frames and the total count
+ */
+static void add_usable_range(uint32_t base, uint32_t length_low, uint32_t length_high) {
+    uint32_t first, last;
+
+    first = (base >> FRAME_SHIFT) + ((base & (FRAME_SIZE - 1)) != 0);
+    if (length_high != 0 || base + length_low < base)
+        last = MAX_FRAMES;
+    else
+        last = (base + length_low) >> FRAME_SHIFT;
+    if (first >= last)
+        return;
+
+    mark_frames(first, last - first, 0);
+    frame_stats.total = frame_stats.free;
+    if (last > num_frames)
+        num_frames = last;
+}
+
+/**
+ * reserve_range
+ *
+ * Description: Marks every frame touching a range of bytes as used
+ * Inputs: start - first byte, end - byte after the range
+ * Outputs: none
+ * Side Effects: Takes frames out of the free pool for good
+ */
+static void reserve_range(uint32_t start, uint32_t end) {
+    uint32_t first = start >> FRAME_SHIFT;
+    uint32_t last = (end >> FRAME_SHIFT) + ((end & (FRAME_SIZE - 1)) != 0);
+
+    if (end == 0)   // an end of 0 wrapped past 4GB
+        last = MAX_FRAMES;
+    if (first < last)
+        mark_frames(first, last - first, 1);
+}
+
+/**
+ * find_free_run
+ *
+ * Description: First fit search for count free frames starting on a multiple of align
+ * Inputs: start, end - frame numbers to search between
+ *         count - frames needed
+ *         align - alignment of the first frame, a power of 2
+ * Outputs: First frame of the run, or end if there is none
+ * Side Effects: none
+ */
+static uint32_t find_free_run(uint32_t start, uint32_t end, uint32_t count, uint32_t align) {
+    uint32_t i, j;
+
+    i = (start + align - 1) & ~(align - 1);
+    while (i + count <= end && i + count > i) {
+        for (j = 0; j < count; j++) {
+            if (frame_bitmap[(i + j) / BITS_PER_WORD] & (1 << ((i + j) % BITS_PER_WORD)))
+                break;
+        }
+        if (j == count)
+            return i;
+        // the next candidate starts after the used frame
+        i = (i + j + align) & ~(align - 1);
+    }
+    return end;
+}
+
+/**
+ * init_frames
+ *
+ * Description: Builds the frame bitmap from the multiboot memory map, or from mem_upper
+ *              when the boot loader gave no map. Low memory, the kernel image, the boot
+ *              stack and the modules are reserved
+ * Inputs: mbi - multiboot information
+ * Outputs: 0 on success, -1 if the boot loader said nothing about memory
+ * Side Effects: Fills the frame bitmap
+ */
+int32_t init_frames(multiboot_info_t* mbi) {
+    memory_map_t* mmap;
+    module_t* mod;
+    uint32_t i;
+
+    memset(frame_bitmap, 0xFF, sizeof(frame_bitmap));
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    num_frames = 0;
+
+    // bit 6 is a valid mmap, bit 0 valid mem_lower and mem_upper
+    if (mbi->flags & (1 << 6)) {
+        for (mmap = (memory_map_t*)mbi->mmap_addr;
+             (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+             mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))) {
+            if (mmap->type == MULTIBOOT_MEM_AVAILABLE && mmap->base_addr_high == 0)
+                add_usable_range(mmap->base_addr_low, mmap->length_low, mmap->length_high);
+        }
+    } else if (mbi->flags & (1 << 0)) {
+        add_usable_range(LOW_MEM_END, mbi->mem_upper * 1024, 0);
+    } else {
+        return -1;
+    }
+
+    reserve_range(0, LOW_MEM_END);
+    reserve_range(KERNEL_MEM_START, (uint32_t)_end);
+    reserve_range(KERNEL_MEM_END - BOOT_STACK_SIZE, KERNEL_MEM_END);
+    // bit 3 is valid mods
+    if (mbi->flags & (1 << 3)) {
+        mod = (module_t*)mbi->mods_addr;
+        for (i = 0; i < mbi->mods_count; i++, mod++)
+            reserve_range(mod->mod_start, mod->mod_end);
+    }
+
+    next_frame = KERNEL_MEM_END >> FRAME_SHIFT;
+    return 0;
+}
+
+/**
+ * alloc_frame
+ *
+ * Description: Next fit search for a free 4KB frame outside the kernel's 4MB page, skipping
+ *              full bitmap words. The frame is only reachable through a page table entry
+ * Inputs: none
+ * Outputs: Physical address of the frame, 0 if every frame is used
+ * Side Effects: Marks the frame used
+ */
+uint32_t alloc_frame() {
+    uint32_t flags, word, start_word, end_word, kernel_start, kernel_end, frame, n;
+
+    start_word = (LOW_MEM_END >> FRAME_SHIFT) / BITS_PER_WORD;
+    kernel_start = (KERNEL_MEM_START >> FRAME_SHIFT) / BITS_PER_WORD;
+    kernel_end = (KERNEL_MEM_END >> FRAME_SHIFT) / BITS_PER_WORD;
+
+    cli_and_save(flags);
+    end_word = (num_frames + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    word = next_frame / BITS_PER_WORD;
+    for (n = 0; n < end_word; n++) {
+        // the kernel's page is left to alloc_kernel_frames, the search wraps at the end
+        if (word >= kernel_start && word < kernel_end)
+            word = kernel_end;
+        if (word >= end_word || word < start_word)
+            word = start_word;
+
+        if (frame_bitmap[word] != FULL_WORD) {
+            for (frame = word * BITS_PER_WORD; frame_bitmap[word] & (1 << (frame % BITS_PER_WORD)); frame++);
+            if (frame < num_frames) {
+                mark_frames(frame, 1, 1);
+                next_frame = frame + 1;
+                restore_flags(flags);
+                return frame << FRAME_SHIFT;
+            }
+        }
+        word++;
+    }
+
+    restore_flags(flags);
+    return 0;
+}
+
+/**
+ * alloc_kernel_frames
+ *
+ * Description: Allocates contiguous frames in the kernel's 4MB page, which is mapped at
+ *              its physical address, for kernel stacks and other kernel buffers
+ * Inputs: count - 4KB frames needed, the run is aligned to count rounded up to a power of 2
+ * Outputs: Address of the first frame, 0 if the kernel's memory is full
+ * Side Effects: Marks the frames used
+ */
+uint32_t alloc_kernel_frames(uint32_t count) {
+    uint32_t flags, align, first, start, end;
+
+    if (count == 0 || count > FRAMES_PER_4MB)
+        return 0;
+    for (align = 1; align < count; align <<= 1);
+
+    start = KERNEL_MEM_START >> FRAME_SHIFT;
+    end = KERNEL_MEM_END >> FRAME_SHIFT;
+    cli_and_save(flags);
+    first = find_free_run(start, end, count, align);
+    if (first == end) {
+        restore_flags(flags);
+        return 0;
+    }
+    mark_frames(first, count, 1);
+    restore_flags(flags);
+    return first << FRAME_SHIFT;
+}
+
+/**
+ * free_frames
+ *
+ * Description: Returns frames to the free pool
+ * Inputs: addr - physical address of the first frame, 4KB aligned
+ *         count - 4KB frames to free
+ * Outputs: none
+ * Side Effects: Marks the frames free
+ */
+void free_frames(uint32_t addr, uint32_t count) {
+    uint32_t flags;
+
+    if (addr == 0 || (addr & (FRAME_SIZE - 1)))
+        return;
+    cli_and_save(flags);
+    mark_frames(addr >> FRAME_SHIFT, count, 0);
+    restore_flags(flags);
+}
+
+/**
+ * get_frame_stats
+ *
+ * Description: Copies the frame counters
+ * Inputs: stats - filled with the counters
+ * Outputs: none
+ * Side Effects: none
+ */
+void get_frame_stats(frame_stats_t* stats) {
+    uint32_t flags;
+
+    if (stats == NULL)
+        return;
+    cli_and_save(flags);
+    *stats = frame_stats;
+    restore_flags(flags);
+}
@@ -0,0 +1,38 @@
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "lib.h"
+#include "multiboot.h"
+
+#define FRAME_SIZE              0x1000      // 4KB frame
+#define FRAMES_PER_4MB          1024        // 4KB frames in one 4MB frame
+#define MAX_FRAMES              0x100000    // 4GB of 4KB frames, memory above 4GB is ignored
+#define LOW_MEM_END             0x100000    // BIOS, VGA memory and the multiboot structures
+#define KERNEL_MEM_START        0x400000    // the kernel's 4MB page, mapped at the same address
+#define KERNEL_MEM_END          0x800000
+#define BOOT_STACK_SIZE         0x2000      // below KERNEL_MEM_END, set up in boot.S
+#define MULTIBOOT_MEM_AVAILABLE 1           // memory_map_t type of usable RAM
+
+// counters for the frame allocator, read with get_frame_stats
+typedef struct frame_stats_t {
+    uint32_t total;         // 4KB frames of usable RAM
+    uint32_t free;          // 4KB frames not allocated or reserved
+} frame_stats_t;
+
+// Builds the free frame bitmap from the multiboot memory map
+int32_t init_frames(multiboot_info_t* mbi);
+
+// Allocates a 4KB frame outside the kernel's memory, 0 if memory is full
+uint32_t alloc_frame();
+
+// Allocates count contiguous 4KB frames the kernel can address, aligned to count frames
+uint32_t alloc_kernel_frames(uint32_t count);
+
+// Frees count 4KB frames starting at addr
+void free_frames(uint32_t addr, uint32_t count);
+
+// Copies the allocator counters into stats
+void get_frame_stats(frame_stats_t* stats);
+
+#endif /* _FRAME_H */
@@ -15,6 +15,8 @@
 #include "filesys.h"
 #include "system_call.h"
 #include "scheduler.h"
+#include "frame.h"
+#include "kmalloc.h"
 
 // #define RUN_TESTS
 
@@ -43,7 +45,9 @@ void entry(unsigned long magic, unsigned long addr) {
     module_t* fsmod = (module_t*)mbi->mods_addr; // defined fsmod
     // printf("fsmod: %x\n", fsmod);
     // printf("fsmod->mod_start: %x\n", fsmod->mod_start);
-    uint32_t* filesysStart = (uint32_t*)fsmod->mod_start;
+    uint32_t* filesysStart = NULL;
+    if (CHECK_FLAG(mbi->flags, 3) && mbi->mods_count > 0)
+        filesysStart = (uint32_t*)fsmod->mod_start;
 
     /* Print out the flags. */
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
@@ -151,6 +155,14 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
 
+    // frames for processes, kernel stacks and video backing pages come from the memory map
+    if (init_frames(mbi))
+        printf("No memory map\n");
+
+    // init the kernel heap and the caches processes come from
+    kmalloc_init();
+    init_processes();
+
     // init the paging
     init_paging();
     /* Init the PIC */
@@ -160,9 +172,13 @@ void entry(unsigned long magic, unsigned long addr) {
     //init the RTC
     init_rtc();
     // init PIT
-    init_pit();
+    init_pit(CHECK_FLAG(mbi->flags, 2) ? (int8_t*)mbi->cmdline : NULL);
 
-    init_filesys(filesysStart);
+    // without a module the filesystem is read from the disk
+    if (filesysStart != NULL)
+        init_filesys(filesysStart);
+    else if (init_filesys_disk())
+        printf("No filesystem module or disk\n");
 
     clear();
     reset_cursor();
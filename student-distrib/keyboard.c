@@ -222,6 +222,7 @@ void get_keyboard_input(){
         }
         if (keyboard_buf[terminal->_buffer_loc-1] == new_line) {                               // if newline char, set enter flag for Terminal
             ((terminal_t *)terminal_data[getDisplayTerm()])->_enter_flag = 1; 
+            terminal_wake_readers(getDisplayTerm());
             store_deleted_line();                                                   // keep track of which line to stop deleting at 
             terminal->_buffer_loc = 0;                                                         // reset keyboard buffer
         }
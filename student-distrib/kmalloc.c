@@ -0,0 +1,370 @@
+#include "kmalloc.h"
+
+#define KERNEL_FRAMES           ((KERNEL_MEM_END - KERNEL_MEM_START) / FRAME_SIZE)
+#define KMALLOC_CLASSES         7       // 32 to 2048 bytes
+
+static kmem_cache_t kmem_caches[KMEM_MAX_CACHES];
+static uint32_t num_caches;
+static kmem_cache_t* slab_header_cache;             /* headers of off slab caches */
+static kmem_cache_t* kmalloc_caches[KMALLOC_CLASSES];
+static kmem_slab_t* frame_slabs[KERNEL_FRAMES];     /* slab each frame of the kernel's page belongs to */
+static uint16_t large_frames[KERNEL_FRAMES];        /* frames of a large kmalloc, at its first frame */
+
+/**
+ * frame_index
+ *
+ * Description: Index of the kernel page frame holding an address
+ * Inputs: ptr - address in the kernel's page
+ * Outputs: Frame index, KERNEL_FRAMES for an address outside the page
+ * Side Effects: none
+ */
+static uint32_t frame_index(const void* ptr) {
+    if ((uint32_t)ptr < KERNEL_MEM_START || (uint32_t)ptr >= KERNEL_MEM_END)
+        return KERNEL_FRAMES;
+    return ((uint32_t)ptr - KERNEL_MEM_START) / FRAME_SIZE;
+}
+
+/**
+ * slab_list_remove
+ *
+ * Description: Unlinks a slab from one of its cache's lists
+ * Inputs: list - head of the list, slab - slab on it
+ * Outputs: none
+ * Side Effects: Changes the list
+ */
+static void slab_list_remove(kmem_slab_t** list, kmem_slab_t* slab) {
+    if (slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+    if (slab->next != NULL)
+        slab->next->prev = slab->prev;
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+/**
+ * slab_list_push
+ *
+ * Description: Links a slab at the head of one of its cache's lists
+ * Inputs: list - head of the list, slab - slab on no list
+ * Outputs: none
+ * Side Effects: Changes the list
+ */
+static void slab_list_push(kmem_slab_t** list, kmem_slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL)
+        (*list)->prev = slab;
+    *list = slab;
+}
+
+/**
+ * slab_first_object
+ *
+ * Description: Offset of the first object in a slab, after an on slab header
+ * Inputs: cache - cache of the slab
+ * Outputs: Offset in bytes, a multiple of the cache's alignment
+ * Side Effects: none
+ */
+static uint32_t slab_first_object(const kmem_cache_t* cache) {
+    if (cache->off_slab)
+        return 0;
+    return (sizeof(kmem_slab_t) + cache->align - 1) & ~(cache->align - 1);
+}
+
+/**
+ * grow_cache
+ *
+ * Description: Allocates a slab for a cache and threads its objects on a free list
+ * Inputs: cache - cache with no free objects
+ * Outputs: The new slab, NULL if the kernel's memory is full
+ * Side Effects: Allocates kernel frames, puts the slab on the empty list.
+ *               Callers keep interrupts off
+ */
+static kmem_slab_t* grow_cache(kmem_cache_t* cache) {
+    kmem_slab_t* slab;
+    uint8_t* mem;
+    uint32_t i, first;
+
+    mem = (uint8_t*)alloc_kernel_frames(cache->slab_frames);
+    if (mem == NULL)
+        return NULL;
+    if (cache->off_slab) {
+        slab = kmem_cache_alloc(slab_header_cache);
+        if (slab == NULL) {
+            free_frames((uint32_t)mem, cache->slab_frames);
+            return NULL;
+        }
+    } else {
+        slab = (kmem_slab_t*)mem;
+    }
+
+    slab->cache = cache;
+    slab->mem = mem;
+    slab->in_use = 0;
+    slab->free_list = NULL;
+    // thread the objects back to front so the first one is handed out first
+    first = slab_first_object(cache);
+    for (i = cache->per_slab; i > 0; i--) {
+        *(void**)(mem + first + (i - 1) * cache->stats.obj_size) = slab->free_list;
+        slab->free_list = mem + first + (i - 1) * cache->stats.obj_size;
+    }
+    for (i = 0; i < cache->slab_frames; i++)
+        frame_slabs[frame_index(mem) + i] = slab;
+
+    slab_list_push(&cache->empty, slab);
+    cache->stats.slabs++;
+    cache->stats.total += cache->per_slab;
+    return slab;
+}
+
+/**
+ * destroy_slab
+ *
+ * Description: Returns an empty slab's frames to the frame allocator
+ * Inputs: cache - cache of the slab, slab - slab on no list with no objects in use
+ * Outputs: none
+ * Side Effects: Frees kernel frames. Callers keep interrupts off
+ */
+static void destroy_slab(kmem_cache_t* cache, kmem_slab_t* slab) {
+    uint8_t* mem = slab->mem;
+    uint32_t i;
+
+    for (i = 0; i < cache->slab_frames; i++)
+        frame_slabs[frame_index(mem) + i] = NULL;
+    cache->stats.slabs--;
+    cache->stats.total -= cache->per_slab;
+    if (cache->off_slab)
+        kmem_cache_free(slab_header_cache, slab);
+    free_frames((uint32_t)mem, cache->slab_frames);
+}
+
+/**
+ * kmem_cache_create
+ *
+ * Description: Sets up a cache. Its slabs are the smallest power of 2 frames that hold
+ *              KMEM_MIN_OBJECTS objects, and big objects keep their headers off the slab
+ *              so an aligned object isn't pushed out by the header
+ * Inputs: name - shown in the stats
+ *         size - bytes in each object, at least a pointer
+ *         align - alignment of each object, a power of 2, 0 for 4 bytes
+ * Outputs: The cache, NULL if there are KMEM_MAX_CACHES already or size is too big
+ * Side Effects: None until the first allocation
+ */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size, uint32_t align) {
+    kmem_cache_t* cache;
+    uint32_t flags;
+
+    if (align < sizeof(void*))
+        align = sizeof(void*);
+    if ((align & (align - 1)) || size == 0 || size > FRAMES_PER_4MB / KMEM_MIN_OBJECTS * FRAME_SIZE)
+        return NULL;
+
+    cli_and_save(flags);
+    if (num_caches == KMEM_MAX_CACHES) {
+        restore_flags(flags);
+        return NULL;
+    }
+    cache = &kmem_caches[num_caches++];
+    restore_flags(flags);
+
+    memset(cache, 0, sizeof(kmem_cache_t));
+    strncpy(cache->stats.name, name, KMEM_NAME_LEN - 1);
+    cache->align = align;
+    cache->stats.obj_size = (size + align - 1) & ~(align - 1);
+    cache->off_slab = cache->stats.obj_size >= KMEM_OFF_SLAB_SIZE;
+    for (cache->slab_frames = 1; ; cache->slab_frames <<= 1) {
+        cache->per_slab = (cache->slab_frames * FRAME_SIZE - slab_first_object(cache)) / cache->stats.obj_size;
+        if (cache->per_slab >= KMEM_MIN_OBJECTS)
+            break;
+    }
+    return cache;
+}
+
+/**
+ * kmem_cache_alloc
+ *
+ * Description: Takes an object from a partly used slab, then the empty slab, then a new one
+ * Inputs: cache - cache to allocate from
+ * Outputs: The object, its contents undefined, NULL if the kernel's memory is full
+ * Side Effects: May allocate a slab, updates the cache's counters
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    kmem_slab_t* slab;
+    void* obj;
+    uint32_t flags;
+
+    if (cache == NULL)
+        return NULL;
+
+    cli_and_save(flags);
+    slab = cache->partial;
+    if (slab == NULL) {
+        if (cache->empty == NULL && grow_cache(cache) == NULL) {
+            cache->stats.failures++;
+            restore_flags(flags);
+            return NULL;
+        }
+        slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+
+    obj = slab->free_list;
+    slab->free_list = *(void**)obj;
+    if (++slab->in_use == cache->per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+    cache->stats.active++;
+    cache->stats.allocs++;
+    restore_flags(flags);
+    return obj;
+}
+
+/**
+ * kmem_cache_free
+ *
+ * Description: Puts an object back on its slab's free list. A slab left with nothing in use
+ *              becomes the cache's empty slab, or is freed if there already is one
+ * Inputs: cache - cache the object came from
+ *         obj - object, ignored if it isn't from this cache
+ * Outputs: none
+ * Side Effects: May free a slab, updates the cache's counters
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    kmem_slab_t* slab;
+    uint32_t flags, idx;
+
+    idx = frame_index(obj);
+    if (cache == NULL || idx == KERNEL_FRAMES)
+        return;
+
+    cli_and_save(flags);
+    slab = frame_slabs[idx];
+    if (slab == NULL || slab->cache != cache || slab->in_use == 0) {
+        restore_flags(flags);
+        return;
+    }
+
+    *(void**)obj = slab->free_list;
+    slab->free_list = obj;
+    if (slab->in_use-- == cache->per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty == NULL)
+            slab_list_push(&cache->empty, slab);
+        else
+            destroy_slab(cache, slab);
+    }
+    cache->stats.active--;
+    cache->stats.frees++;
+    restore_flags(flags);
+}
+
+/**
+ * kmalloc_init
+ *
+ * Description: Creates the slab header cache and the power of 2 kmalloc size classes
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Fills the first caches
+ */
+void kmalloc_init() {
+    int8_t name[KMEM_NAME_LEN] = "kmalloc-";
+    uint32_t i;
+
+    slab_header_cache = kmem_cache_create((int8_t*)"slab", sizeof(kmem_slab_t), 0);
+    for (i = 0; i < KMALLOC_CLASSES; i++) {
+        itoa(KMALLOC_MIN_SIZE << i, name + 8, 10);      // 8 is strlen("kmalloc-")
+        kmalloc_caches[i] = kmem_cache_create(name, KMALLOC_MIN_SIZE << i, 0);
+    }
+}
+
+/**
+ * kmalloc
+ *
+ * Description: Allocates from the smallest size class that fits. Anything bigger than
+ *              KMALLOC_MAX_SIZE takes whole frames, their count kept for kfree
+ * Inputs: size - bytes needed
+ * Outputs: Pointer to the memory, NULL for 0 bytes or when the kernel's memory is full
+ * Side Effects: Allocates from a cache or the frame allocator
+ */
+void* kmalloc(uint32_t size) {
+    uint32_t i, count, addr, flags;
+
+    if (size == 0)
+        return NULL;
+    for (i = 0; i < KMALLOC_CLASSES; i++) {
+        if (size <= (KMALLOC_MIN_SIZE << i))
+            return kmem_cache_alloc(kmalloc_caches[i]);
+    }
+
+    if (size > KERNEL_MEM_END - KERNEL_MEM_START)
+        return NULL;
+    count = (size + FRAME_SIZE - 1) / FRAME_SIZE;
+    addr = alloc_kernel_frames(count);
+    if (addr == 0)
+        return NULL;
+    cli_and_save(flags);
+    large_frames[frame_index((void*)addr)] = count;
+    restore_flags(flags);
+    return (void*)addr;
+}
+
+/**
+ * kfree
+ *
+ * Description: Frees memory from kmalloc, finding its cache through the slab of its frame
+ * Inputs: ptr - memory from kmalloc, NULL is ignored
+ * Outputs: none
+ * Side Effects: Returns the memory to its cache or the frame allocator
+ */
+void kfree(void* ptr) {
+    uint32_t idx, count, flags;
+    kmem_slab_t* slab;
+
+    idx = frame_index(ptr);
+    if (idx == KERNEL_FRAMES)
+        return;
+
+    cli_and_save(flags);
+    slab = frame_slabs[idx];
+    count = large_frames[idx];
+    if (slab == NULL && count != 0 && !((uint32_t)ptr & (FRAME_SIZE - 1)))
+        large_frames[idx] = 0;
+    restore_flags(flags);
+
+    if (slab != NULL)
+        kmem_cache_free(slab->cache, ptr);
+    else if (count != 0 && !((uint32_t)ptr & (FRAME_SIZE - 1)))
+        free_frames((uint32_t)ptr, count);
+}
+
+/**
+ * get_kmem_cache_stats
+ *
+ * Description: Copies one cache's counters, caches are numbered in creation order
+ * Inputs: index - cache number
+ *         stats - filled with the counters
+ * Outputs: 0 on success, -1 if there is no such cache
+ * Side Effects: none
+ */
+int32_t get_kmem_cache_stats(uint32_t index, kmem_cache_stats_t* stats) {
+    uint32_t flags;
+
+    if (stats == NULL)
+        return -1;
+    cli_and_save(flags);
+    if (index >= num_caches) {
+        restore_flags(flags);
+        return -1;
+    }
+    *stats = kmem_caches[index].stats;
+    restore_flags(flags);
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef _KMALLOC_H
+#define _KMALLOC_H
+
+#include "types.h"
+#include "lib.h"
+#include "frame.h"
+
+#define KMEM_MAX_CACHES         24
+#define KMEM_NAME_LEN           16
+#define KMEM_MIN_OBJECTS        4       // a slab holds at least this many objects
+#define KMEM_OFF_SLAB_SIZE      512     // objects this big keep their slab header in another cache
+#define KMALLOC_MIN_SIZE        32      // smallest kmalloc size class
+#define KMALLOC_MAX_SIZE        2048    // bigger kmallocs take whole frames
+
+// slab of one cache, a power of 2 frames of the kernel's page
+typedef struct kmem_slab_t {
+    struct kmem_cache_t* cache;
+    struct kmem_slab_t* prev;
+    struct kmem_slab_t* next;
+    uint8_t* mem;               // first frame of the slab
+    void* free_list;            // free objects, linked through their first word
+    uint32_t in_use;
+} kmem_slab_t;
+
+// counters for one cache, read with get_kmem_cache_stats
+typedef struct kmem_cache_stats_t {
+    int8_t name[KMEM_NAME_LEN];
+    uint32_t obj_size;
+    uint32_t active;            // objects allocated now
+    uint32_t total;             // objects the cache's slabs hold
+    uint32_t slabs;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;          // allocations refused because the kernel's memory is full
+} kmem_cache_stats_t;
+
+// objects of one size and alignment, carved out of slabs
+typedef struct kmem_cache_t {
+    uint32_t align;
+    uint32_t slab_frames;
+    uint32_t per_slab;          // objects in one slab
+    uint32_t off_slab;          // 1 if slab headers come from the slab header cache
+    kmem_slab_t* partial;
+    kmem_slab_t* full;
+    kmem_slab_t* empty;         // at most one empty slab is kept
+    kmem_cache_stats_t stats;
+} kmem_cache_t;
+
+// Creates the kmalloc size classes, after init_frames
+void kmalloc_init();
+
+// Creates a cache of objects of size bytes aligned to align, a power of 2
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size, uint32_t align);
+
+// Allocates an object from a cache, NULL if the kernel's memory is full
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+// Returns an object to the cache it came from
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+// Allocates size bytes from the smallest size class that fits, or whole frames
+void* kmalloc(uint32_t size);
+
+// Frees memory from kmalloc
+void kfree(void* ptr);
+
+// Copies the counters of the cache at index, -1 past the last cache
+int32_t get_kmem_cache_stats(uint32_t index, kmem_cache_stats_t* stats);
+
+#endif /* _KMALLOC_H */
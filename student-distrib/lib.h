@@ -122,7 +122,7 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %1, (%w0)"      \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
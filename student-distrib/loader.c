@@ -0,0 +1,278 @@
+#include "loader.h"
+#include "system_call.h"
+
+typedef struct exec_cache_entry_t {
+    uint32_t valid;
+    uint32_t last_used;                     // exec_cache_clock at the last hit, lowest is evicted
+    exec_image_t image;
+    uint32_t shared_ptes[IMAGE_MAX_PAGES];  // page table entries for USER_IMAGE_START on, 0 for private pages
+} exec_cache_entry_t;
+
+static exec_cache_entry_t exec_cache[EXEC_CACHE_SIZE];
+static uint32_t exec_cache_clock = 0;
+static exec_cache_stats_t exec_cache_stats;
+
+/** 
+ * load_exec_image
+ * 
+ * Description: Validates the ELF header of an executable and marks the pages of its
+ *              flat image that only read-only PT_LOAD segments touch. Those pages are
+ *              never written, so they map straight to the file's data blocks and are
+ *              shared by every process running the same inode.
+ * Inputs: inode - inode of the executable
+ *         image - filled with the entry point and page layout of the image
+ * Outputs: 0 on success, -1 if the file is not an executable we can load
+ * Side Effects: None
+ */
+int32_t load_exec_image(uint32_t inode, exec_image_t* image) {
+    uint8_t elf_header[ELF_HEADER_LEN];
+    elf_phdr_t phdrs[ELF_MAX_PHDRS];
+    uint32_t phoff, phnum, num_pages, page_start, page_end, i, j;
+    int32_t read_only, writable;
+
+    if (image == NULL)
+        return -1;
+
+    // one read for the header: bytes 0-3 are the magic number, bytes 24-27 the entry point EIP
+    if (read_data(inode, 0, elf_header, ELF_HEADER_LEN) != ELF_HEADER_LEN)
+        return -1;
+
+    // compare the magic 4 bytes to expected values from first 4 bytes of executable
+    if (elf_header[0] != 0x7f || elf_header[1] != 0x45 || elf_header[2] != 0x4C || elf_header[3] != 0x46)
+        return -1;
+
+    memset(image, 0, sizeof(exec_image_t));
+    image->inode = inode;
+    image->length = get_file_len_by_inode(inode);
+    image->entry_point = *((uint32_t*)(elf_header + ELF_ENTRY_OFFSET));
+
+    // the whole file is placed at USER_IMAGE_START, it has to fit below the user stack page
+    num_pages = (image->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (num_pages > IMAGE_MAX_PAGES)
+        return -1;
+
+    // without readable program headers every page is private, like a plain copy
+    phoff = *((uint32_t*)(elf_header + ELF_PHOFF_OFFSET));
+    phnum = *((uint16_t*)(elf_header + ELF_PHNUM_OFFSET));
+    if (*((uint16_t*)(elf_header + ELF_PHENTSIZE_OFFSET)) != sizeof(elf_phdr_t) || phnum > ELF_MAX_PHDRS)
+        return 0;
+    if (read_data(inode, phoff, (uint8_t*)phdrs, phnum * sizeof(elf_phdr_t)) != phnum * sizeof(elf_phdr_t))
+        return 0;
+
+    for (i = 0; i < num_pages; i++) {
+        page_start = USER_IMAGE_START + i * BLOCK_SIZE;
+        page_end = page_start + BLOCK_SIZE;
+        read_only = 0;
+        writable = 0;
+        for (j = 0; j < phnum; j++) {
+            if (phdrs[j].type != PT_LOAD || phdrs[j].vaddr >= page_end || phdrs[j].vaddr + phdrs[j].memsz <= page_start)
+                continue;
+            if (phdrs[j].flags & PF_W)
+                writable = 1;
+            else
+                read_only = 1;
+        }
+        // a page shared with a writable segment (data, bss) has to stay private
+        if (read_only && !writable)
+            image->shared_pages[i / 32] |= 1 << (i % 32);
+    }
+
+    return 0;
+}
+
+/** 
+ * handle_user_page_fault
+ * 
+ * Description: Demand pages the current process's 128MB page. Shared image pages map
+ *              the file's data block read-only, every other page gets a 4kb frame of its
+ *              own, filled from the file or zeroed, so a process only holds the memory it touches.
+ * Inputs: fault_addr - CR2 at the fault
+ *         error_code - error code pushed by the processor
+ * Outputs: 0 if the page is now present, -1 if this is a real page fault, memory is full
+ *          or the page couldn't be read from the file
+ * Side Effects: Maps one 4kb page in the process's user page table, may allocate a frame
+ */
+int32_t handle_user_page_fault(uint32_t fault_addr, uint32_t error_code) {
+    uint32_t page, idx, frame;
+    int32_t in_image;
+    uint8_t* block;
+
+    // writes to read-only pages and addresses outside the user page are real faults
+    if (error_code & PF_ERR_PRESENT)
+        return -1;
+    if (fault_addr < USER_MEM_START || fault_addr >= USER_MEM_START + USER_MEM_SIZE)
+        return -1;
+    if (terminal_process_num[getExecuteTerm()] < 0)
+        return -1;
+
+    pcb_t* pcb = getPCB();
+    page = fault_addr & ~BITMASK_12BIT;
+    idx = (page - USER_IMAGE_START) / BLOCK_SIZE;
+    in_image = page >= USER_IMAGE_START && idx * BLOCK_SIZE < pcb->image.length;
+
+    if (in_image && (pcb->image.shared_pages[idx / 32] & (1 << (idx % 32)))) {
+        block = get_data_block_addr(pcb->image.inode, idx);
+        if (block != NULL && !((uint32_t)block & BITMASK_12BIT)) {
+            map_user_4kb_page(pcb->user_page_table, page, (uint32_t)block, 0, CACHE_WB);
+            return 0;
+        }
+    }
+
+    // private page in a frame of its own, the stack and bss start out zeroed
+    frame = alloc_frame();
+    if (frame == 0)
+        return -1;
+    map_user_4kb_page(pcb->user_page_table, page, frame, 1, CACHE_WB);
+    pcb->user_pages++;
+    memset((void*)page, 0, BLOCK_SIZE);
+    if (in_image && read_data(pcb->image.inode, idx * BLOCK_SIZE, (uint8_t*)page, BLOCK_SIZE) < 0) {
+        // a page that couldn't be read must not run zeroed, the fault kills the process instead
+        pcb->user_page_table[(page >> 12) & BITMASK_10BIT] = 0;
+        invalidate_page(page);
+        free_frames(frame, 1);
+        pcb->user_pages--;
+        return -1;
+    }
+
+    return 0;
+}
+
+/** 
+ * find_exec_cache_entry
+ * 
+ * Description: Linear search of the exec cache, it only holds EXEC_CACHE_SIZE entries
+ * Inputs: inode - inode of the executable
+ * Outputs: the cached entry, NULL if the inode is not cached
+ * Side Effects: None
+ */
+static exec_cache_entry_t* find_exec_cache_entry(uint32_t inode) {
+    uint32_t i;
+    for (i = 0; i < EXEC_CACHE_SIZE; i++) {
+        if (exec_cache[i].valid && exec_cache[i].image.inode == inode)
+            return &exec_cache[i];
+    }
+    return NULL;
+}
+
+/** 
+ * get_exec_image
+ * 
+ * Description: Looks up an executable in the exec cache. On a miss the ELF header is
+ *              validated with load_exec_image and the page table entries of its shared
+ *              pages are built once, replacing the least recently used entry.
+ * Inputs: inode - inode of the executable
+ *         image - filled with the cached image
+ * Outputs: 0 on success, -1 if the file is not an executable we can load
+ * Side Effects: Updates the exec cache and its hit/miss counters
+ */
+int32_t get_exec_image(uint32_t inode, exec_image_t* image) {
+    exec_cache_entry_t* entry;
+    exec_image_t loaded;
+    uint32_t i, flags;
+    uint8_t* block;
+
+    if (image == NULL)
+        return -1;
+
+    cli_and_save(flags);
+    entry = find_exec_cache_entry(inode);
+    if (entry != NULL) {
+        exec_cache_stats.hits++;
+        entry->last_used = ++exec_cache_clock;
+        *image = entry->image;
+        restore_flags(flags);
+        return 0;
+    }
+    exec_cache_stats.misses++;
+    restore_flags(flags);
+
+    // a failed validation is not cached, so a bad file is re-checked every time
+    if (load_exec_image(inode, &loaded) != 0)
+        return -1;
+
+    cli_and_save(flags);
+    // evict an empty entry first, otherwise the one unused the longest
+    entry = &exec_cache[0];
+    for (i = 0; i < EXEC_CACHE_SIZE; i++) {
+        if (!exec_cache[i].valid) {
+            entry = &exec_cache[i];
+            break;
+        }
+        if (exec_cache[i].last_used < entry->last_used)
+            entry = &exec_cache[i];
+    }
+    if (entry->valid)
+        exec_cache_stats.evictions++;
+
+    entry->image = loaded;
+    for (i = 0; i < IMAGE_MAX_PAGES; i++) {
+        entry->shared_ptes[i] = 0;
+        if (!(loaded.shared_pages[i / 32] & (1 << (i % 32))))
+            continue;
+        // only page aligned data blocks can be mapped in place, the rest are faulted in privately
+        block = get_data_block_addr(inode, i);
+        if (block != NULL && !((uint32_t)block & BITMASK_12BIT))
+            entry->shared_ptes[i] = (uint32_t)block | P | US | CACHE_WB;
+    }
+    entry->valid = 1;
+    entry->last_used = ++exec_cache_clock;
+    *image = loaded;
+    restore_flags(flags);
+
+    return 0;
+}
+
+/** 
+ * map_exec_image
+ * 
+ * Description: Maps every shared page of a cached image in one copy of its prepared
+ *              page table entries, so they never have to be faulted in
+ * Inputs: table - cleared user page table of the process
+ *         inode - inode of the executable
+ * Outputs: none
+ * Side Effects: Fills the user page table. Does nothing if the image was evicted,
+ *               its pages are then demand paged instead
+ */
+void map_exec_image(int32_t* table, uint32_t inode) {
+    exec_cache_entry_t* entry;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    entry = find_exec_cache_entry(inode);
+    if (entry != NULL)
+        load_user_page_entries(table, USER_IMAGE_START, entry->shared_ptes, IMAGE_MAX_PAGES);
+    restore_flags(flags);
+}
+
+/** 
+ * exec_cache_invalidate
+ * 
+ * Description: Drops a cached image whose file was written, its page table entries
+ *              would still point at the old data blocks
+ * Inputs: inode - inode of the written file
+ * Outputs: none
+ * Side Effects: Frees the inode's exec cache entry
+ */
+void exec_cache_invalidate(uint32_t inode) {
+    exec_cache_entry_t* entry;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    entry = find_exec_cache_entry(inode);
+    if (entry != NULL)
+        entry->valid = 0;
+    restore_flags(flags);
+}
+
+/** 
+ * get_exec_cache_stats
+ * 
+ * Description: Copy out the exec cache counters for tuning EXEC_CACHE_SIZE
+ * Inputs: stats - filled with the counters
+ * Outputs: none
+ * Side Effects: None
+ */
+void get_exec_cache_stats(exec_cache_stats_t* stats) {
+    if (stats != NULL)
+        *stats = exec_cache_stats;
+}
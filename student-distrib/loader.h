@@ -0,0 +1,67 @@
+#ifndef _LOADER_H
+#define _LOADER_H
+
+#include "types.h"
+
+// only depends on types.h so system_call.h can include it for the pcb
+
+#define USER_IMAGE_START        0x08048000  // program images are linked to execute here
+#define USER_IMAGE_END          0x08400000  // end of the 128MB user page
+#define IMAGE_MAX_PAGES         ((USER_IMAGE_END - USER_IMAGE_START) / 0x1000)
+
+#define ELF_HEADER_LEN          52      // 32 bit ELF header
+#define ELF_ENTRY_OFFSET        24
+#define ELF_PHOFF_OFFSET        28
+#define ELF_PHENTSIZE_OFFSET    42
+#define ELF_PHNUM_OFFSET        44
+#define ELF_MAX_PHDRS           16
+#define PT_LOAD                 1
+#define PF_W                    0x2     // segment is writable
+
+#define PF_ERR_PRESENT          0x1     // page fault error code: page was present, protection violation
+
+typedef struct elf_phdr_t {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} elf_phdr_t;
+
+typedef struct exec_image_t {
+    uint32_t inode;
+    uint32_t length;
+    uint32_t entry_point;
+    uint32_t shared_pages[(IMAGE_MAX_PAGES + 31) / 32];    // bitmap of pages mapped read-only from the file
+} exec_image_t;
+
+#define EXEC_CACHE_SIZE         8       // executables kept validated and ready to map
+
+typedef struct exec_cache_stats_t {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} exec_cache_stats_t;
+
+// Validate an executable and decide which of its pages can be shared read-only
+int32_t load_exec_image(uint32_t inode, exec_image_t* image);
+
+// Find an executable in the exec cache, validating and caching it on a miss
+int32_t get_exec_image(uint32_t inode, exec_image_t* image);
+
+// Prefill a process's user page table with the shared pages of a cached image
+void map_exec_image(int32_t* table, uint32_t inode);
+
+// Drop an executable from the exec cache once its file is written
+void exec_cache_invalidate(uint32_t inode);
+
+// Copy out the exec cache hit/miss counters
+void get_exec_cache_stats(exec_cache_stats_t* stats);
+
+// Fill in a missing page of the current process's 128MB page, 0 if handled
+int32_t handle_user_page_fault(uint32_t fault_addr, uint32_t error_code);
+
+#endif /* _LOADER_H */
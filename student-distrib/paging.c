@@ -1,23 +1,29 @@
 #include "paging.h"
 
+// page table of the vidmap page for the processes of each terminal
+static int32_t vidmap_page_tables[NUM_TERMINALS][KB_SIZE] __attribute__((aligned (4*KB_SIZE)));
+
 /** 
  * init_paging
  * 
  * Description: Initializes paging
  * Inputs: none
  * Outputs: none
- * Side Effects: Calls set_paging_ registers, which writes to CR0, CR3, CR4 (control registers).
- *               Allocates memory for page_directory and video_page_table.
+ * Side Effects: Calls set_paging_ registers, which writes to CR0, CR3, CR4 (control registers),
+ *               and init_pat.
+ *               Allocates memory for page_directory and video_page_table, and the terminals'
+ *               video backing pages, so init_frames runs first.
  */
 void init_paging() {
     int i; /* Loop index */
+    uint32_t vidmem;
 
     // Set up first page table
     page_directory[0] = ((uint32_t)video_page_table) | RW | P;
     
-    // Set kernel 4MB page to second elem of page_directory
+    // Set kernel 4MB page to second elem of page_directory, write-back cached
     // Kernel memory at 4MB = 0x400000
-    page_directory[1] = 0x400000 | PS | RW | P | G | PCD;       // need this have U/S = 0, so moved above this for loop
+    page_directory[1] = 0x400000 | PS | RW | P | G | CACHE_WB;  // need this have U/S = 0, so moved above this for loop
 
     for (i = 0; i < KB_SIZE; i++){
         if (i > 1) {
@@ -29,88 +35,285 @@ void init_paging() {
 
     // Set page table to point to video memory
     // Bit shift by 12 because page_table index bits are bits 12-21 (10 bits)
-    video_page_table[VIDEO >> 12] = VIDEO | RW | P;
+    // kernel pages are global, so loading a process's directory keeps their TLB entries.
+    // Text mode memory is mostly written, so writes are combined
+    // reads of it stay uncached, as the VGA range always was
+    video_page_table[VIDEO >> 12] = VIDEO | RW | P | G | CACHE_WC;
 
+    // the PAT has to be set before the first cached translation
+    init_pat();
     set_paging_registers();
 
-    map_terminal_vidmem(TERMINAL_1_VIDMEM, TERMINAL_1_VIDMEM);
-    map_terminal_vidmem(TERMINAL_2_VIDMEM, TERMINAL_2_VIDMEM);
-    map_terminal_vidmem(TERMINAL_3_VIDMEM, TERMINAL_3_VIDMEM);
+    // video backing pages of the terminals come from the kernel's page, or the spare VGA pages
+    for (i = 0; i < NUM_TERMINALS; i++) {
+        vidmem = alloc_kernel_frames(1);
+        if (vidmem != 0) {
+            memset((void*)vidmem, 0, FRAME_SIZE);
+            terminal_vidmem[i] = vidmem;
+        } else {
+            map_terminal_vidmem(terminal_vidmem[i], terminal_vidmem[i], CACHE_WC);
+        }
+        // vidmap shows the screen for the displayed terminal, the backing page for the others
+        vidmem = i == getDisplayTerm() ? VIDEO : terminal_vidmem[i];
+        set_vidmap_page(i, vidmem, video_cache_type(vidmem));
+    }
 
 }
 
 /** 
- * remove_page
+ * init_pat
  * 
- * Description: Remove a page
- * Inputs: virtual address
- * Outputs: none
- * Side Effects: removes the present bit for the page being closed
+ * Description: Reprograms PAT entry 1 from write-through to write-combining, so CACHE_WC
+ *              selects it. The other entries keep their power on types
+ * Inputs: none
+ * Outputs: 0 on success, -1 if the CPU has no PAT, CACHE_WC then means write-through
+ * Side Effects: Writes the IA32_PAT MSR. Runs before paging is enabled
  */
-void remove_page(uint32_t virtual_addr){
-    uint32_t pd_index = (virtual_addr >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
-    page_directory[pd_index] = 0x00000000;
-    flush_tlb();
+int32_t init_pat() {
+    uint32_t eax, ebx, ecx, edx;
+
+    asm volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if (!(edx & CPUID_PAT))
+        return -1;
+
+    // entries 0-3 are WB, WC, UC-, UC and 4-7 repeat them, one byte per entry
+    eax = PAT_WB | (PAT_WC << 8) | (PAT_UC_MINUS << 16) | (PAT_UC << 24);
+    edx = eax;
+    asm volatile ("wrmsr" : : "c"(IA32_PAT), "a"(eax), "d"(edx));
+    return 0;
+}
+
+/** 
+ * video_cache_type
+ * 
+ * Description: Picks the memory type for video memory or a terminal's backing page
+ * Inputs: physical_addr - address of the page
+ * Outputs: CACHE_WC inside the VGA memory, CACHE_WB for a backing page in RAM, which is
+ *          read back when its terminal is displayed again
+ * Side Effects: none
+ */
+uint32_t video_cache_type(uint32_t physical_addr) {
+    if (physical_addr >= VGA_MEM_START && physical_addr < VGA_MEM_END)
+        return CACHE_WC;
+    return CACHE_WB;
 }
 
 /** 
- * remove_4kb_page
+ * map_terminal_vidmem
  * 
- * Description: Remove a page
- * Inputs: virtual address
+ * Description: Mark page for 4kb video page as present
+ * Inputs: physical address, virtual address, cache - CACHE_* memory type 
  * Outputs: none
- * Side Effects: removes the present bit for the page being closed
+ * Side Effects: Add global kernel page for video, set physical address and flag bits. Only done
+ *               at boot, before any process directory copies the kernel's entries
  */
-void remove_4kb_page(uint32_t virtual_addr){
+void map_terminal_vidmem(uint32_t virtual_addr, uint32_t physical_addr, uint32_t cache) {
     uint32_t pd_index = (virtual_addr >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
     uint32_t pt_index = (virtual_addr >> 12) & 0x3FF; // 12 bit shift and mask to get middle 10 bits
-    page_directory[pd_index] = ((uint32_t)video_page_table) | RW | P | US;
-    video_page_table[pt_index] = 0x00000000;
-    flush_tlb();
+    page_directory[pd_index] = ((uint32_t)video_page_table) | RW | P;
+    video_page_table[pt_index] = physical_addr | RW | P | G | cache;
+    invalidate_page(virtual_addr);
 }
 
 /** 
- * map_virtual_addr_to_physical
+ * init_page_directory
  * 
- * Description: Mark page for user program as present
- * Inputs: physical address, virtual address 
+ * Description: Sets up the page directory of a new process with the kernel's entries
+ * Inputs: directory - 4KB aligned page directory, not loaded
  * Outputs: none
- * Side Effects: Add page for user program, set physical address and flag bits 
+ * Side Effects: Copies the entries below USER_MEM_START from the boot page directory
+ *               and clears the rest. The kernel's entries never change after init_paging
  */
-void map_virtual_addr_to_physical(uint32_t virtual_addr, uint32_t physical_addr) {
-    uint32_t pd_index = (virtual_addr >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
-    page_directory[pd_index] = physical_addr | PS | RW | P | PCD | US;
-    flush_tlb();
+void init_page_directory(int32_t* directory) {
+    uint32_t kernel_entries = (USER_MEM_START >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
+    memcpy(directory, page_directory, kernel_entries * sizeof(int32_t));
+    memset(&directory[kernel_entries], 0, (KB_SIZE - kernel_entries) * sizeof(int32_t));
 }
 
 /** 
- * map_virtual_addr_to_physical_4kb_page
+ * load_page_directory
  * 
- * Description: Mark page for user program as present
- * Inputs: physical address, virtual address 
+ * Description: Switches to the address space of a page directory
+ * Inputs: directory - 4KB aligned page directory, page_directory for the kernel's alone
  * Outputs: none
- * Side Effects: Add page for user program, set physical address and flag bits 
+ * Side Effects: Writes CR3, which drops every TLB entry except the global kernel pages
  */
-void map_virtual_addr_to_physical_4kb_page(uint32_t virtual_addr, uint32_t physical_addr) {
-    uint32_t pd_index = (virtual_addr >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
+void load_page_directory(int32_t* directory) {
+    asm volatile (
+        "   movl %0, %%cr3      \n"
+        : /* no outputs */
+        : "r"(directory)
+        : "memory"
+    );
+}
+
+/** 
+ * invalidate_page
+ * 
+ * Description: Drops the TLB entry of one page of the loaded address space
+ * Inputs: virtual address in the page
+ * Outputs: none
+ * Side Effects: invlpg, the rest of the TLB is kept
+ */
+void invalidate_page(uint32_t virtual_addr) {
+    asm volatile (
+        "   invlpg (%0)         \n"
+        : /* no outputs */
+        : "r"(virtual_addr)
+        : "memory"
+    );
+}
+
+/** 
+ * map_user_page_table
+ * 
+ * Description: Point the 128MB user page of a page directory at the page table of a process
+ * Inputs: directory - page directory of the process, not loaded yet
+ *         table - 4KB aligned user page table of the process
+ * Outputs: none
+ * Side Effects: Changes page directory entry for 128MB
+ */
+void map_user_page_table(int32_t* directory, int32_t* table) {
+    uint32_t pd_index = (USER_MEM_START >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
+    directory[pd_index] = ((uint32_t)table) | RW | P | US;
+}
+
+/** 
+ * clear_user_page_table
+ * 
+ * Description: Remove every page in the 128MB user page of a process
+ * Inputs: table - user page table to clear
+ * Outputs: none
+ * Side Effects: Clears the process's user page table. It must not be in the loaded directory,
+ *               so there is no flush
+ */
+void clear_user_page_table(int32_t* table) {
+    memset(table, 0, KB_SIZE * sizeof(int32_t));
+}
+
+/** 
+ * map_user_4kb_page
+ * 
+ * Description: Mark a 4kb user page as present in the 128MB user page of a process
+ * Inputs: table - user page table, virtual address, physical address,
+ *         writable - 1 for a private frame of the process, 0 for a read-only shared page,
+ *         cache - CACHE_* memory type
+ * Outputs: none
+ * Side Effects: Add user page. Only fills entries that were not present,
+ *               which the TLB never caches, so there is no flush
+ */
+void map_user_4kb_page(int32_t* table, uint32_t virtual_addr, uint32_t physical_addr, int32_t writable, uint32_t cache) {
     uint32_t pt_index = (virtual_addr >> 12) & 0x3FF; // 12 bit shift and mask to get middle 10 bits
-    page_directory[pd_index] = ((uint32_t)video_page_table) | RW | P | US;
-    video_page_table[pt_index] = physical_addr | RW | P | US;
-    flush_tlb();
+    table[pt_index] = physical_addr | P | US | (writable ? RW | PRIVATE : 0) | cache;
 }
 
 /** 
- * map_terminal_vidmem
+ * free_user_pages
  * 
- * Description: Mark page for 4kb video page as present
- * Inputs: physical address, virtual address 
+ * Description: Frees the private frames mapped in the 128MB user page of a process,
+ *              shared pages belong to the file system and are left alone
+ * Inputs: table - user page table, not in the loaded directory
+ * Outputs: number of frames freed
+ * Side Effects: Returns frames to the frame allocator, clears their entries
+ */
+uint32_t free_user_pages(int32_t* table) {
+    uint32_t i, freed = 0;
+
+    for (i = 0; i < KB_SIZE; i++) {
+        if ((table[i] & (P | PRIVATE)) == (P | PRIVATE)) {
+            free_frames(table[i] & ~BITMASK_12BIT, 1);
+            freed++;
+        }
+        table[i] = 0;
+    }
+    return freed;
+}
+
+/** 
+ * load_user_page_entries
+ * 
+ * Description: Copy prepared page table entries into the 128MB user page of a process
+ * Inputs: table - user page table, virtual address of the first entry, entries, count - number of entries
  * Outputs: none
- * Side Effects: Add page for video, set physical address and flag bits 
+ * Side Effects: Overwrites the entries in one copy. Meant for a freshly cleared table,
+ *               so there is no flush
  */
-void map_terminal_vidmem(uint32_t virtual_addr, uint32_t physical_addr) {
-    uint32_t pd_index = (virtual_addr >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
+void load_user_page_entries(int32_t* table, uint32_t virtual_addr, const uint32_t* entries, uint32_t count) {
     uint32_t pt_index = (virtual_addr >> 12) & 0x3FF; // 12 bit shift and mask to get middle 10 bits
-    page_directory[pd_index] = ((uint32_t)video_page_table) | RW | P;
-    video_page_table[pt_index] = physical_addr | RW | P;
-    flush_tlb();
+    if (pt_index + count > KB_SIZE)
+        count = KB_SIZE - pt_index;
+    memcpy(&table[pt_index], entries, count * sizeof(uint32_t));
+}
+
+/** 
+ * map_mmap_page_table
+ * 
+ * Description: Point the mmap window of a page directory at the page table of a process
+ * Inputs: directory - page directory of the process, not loaded yet
+ *         table - 4KB aligned mmap page table of the process
+ * Outputs: none
+ * Side Effects: Changes page directory entry for the mmap window
+ */
+void map_mmap_page_table(int32_t* directory, int32_t* table) {
+    uint32_t pd_index = (MMAP_MEM_START >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
+    directory[pd_index] = ((uint32_t)table) | RW | P | US;
+}
+
+/** 
+ * clear_mmap_page_table
+ * 
+ * Description: Remove every page in the mmap window of a process
+ * Inputs: table - mmap page table to clear
+ * Outputs: none
+ * Side Effects: Clears the process's mmap page table. It must not be in the loaded directory,
+ *               so there is no flush
+ */
+void clear_mmap_page_table(int32_t* table) {
+    memset(table, 0, KB_SIZE * sizeof(int32_t));
+}
+
+/** 
+ * map_mmap_readonly_4kb_page
+ * 
+ * Description: Mark a read-only 4kb user page as present in the mmap window
+ * Inputs: table - mmap page table, virtual address, physical address, cache - CACHE_* memory type
+ * Outputs: none
+ * Side Effects: Add read-only user page. Only fills entries that were not present,
+ *               which the TLB never caches, so there is no flush
+ */
+void map_mmap_readonly_4kb_page(int32_t* table, uint32_t virtual_addr, uint32_t physical_addr, uint32_t cache) {
+    uint32_t pt_index = (virtual_addr >> 12) & 0x3FF; // 12 bit shift and mask to get middle 10 bits
+    table[pt_index] = physical_addr | P | US | cache;
+}
+
+/** 
+ * map_vidmap_page_table
+ * 
+ * Description: Maps the vidmap page at 132MB in a process's page directory
+ * Inputs: directory - page directory of the process
+ *         terminal - terminal the process runs on
+ * Outputs: none
+ * Side Effects: Points the page directory entry at the terminal's vidmap page table,
+ *               invalidates the page in case the directory is loaded
+ */
+void map_vidmap_page_table(int32_t* directory, uint32_t terminal) {
+    uint32_t pd_index = ((USER_MEM_START + USER_MEM_SIZE) >> 22) & 0x3FF; // 22 bit shift as the pd_index is the top 10 bits of the virtual addr, 0x3ff masks 10 bits
+    directory[pd_index] = ((uint32_t)vidmap_page_tables[terminal]) | RW | P | US;
+    invalidate_page(USER_MEM_START + USER_MEM_SIZE);
+}
+
+/** 
+ * set_vidmap_page
+ * 
+ * Description: Points the vidmap page of a terminal's processes at physical memory
+ * Inputs: terminal - terminal whose processes see the page
+ *         physical_addr - VIDEO while the terminal is displayed, its backing page otherwise
+ *         cache - CACHE_WC for video memory, CACHE_WB for a backing page in RAM
+ * Outputs: none
+ * Side Effects: Changes the terminal's vidmap page table, invalidates the page in case one
+ *               of its processes is loaded. The others pick it up at their next CR3 load
+ */
+void set_vidmap_page(uint32_t terminal, uint32_t physical_addr, uint32_t cache) {
+    vidmap_page_tables[terminal][0] = physical_addr | RW | P | US | cache;
+    invalidate_page(USER_MEM_START + USER_MEM_SIZE);
 }
@@ -23,9 +23,25 @@
 #define PAT     0x00000080
 #define G       0x00000100
 #define AVAIL   0x00000E00
+#define PRIVATE 0x00000200  // available bit 9, the page's frame belongs to the process
 
+// memory types for the mapping functions, the PAT index bits of an entry
+#define CACHE_WB    0               // write-back, normal memory
+#define CACHE_WC    PWT             // write-combining, init_pat reprograms PAT entry 1 from write-through
+#define CACHE_UC    (PCD | PWT)     // uncached
 
-// Page directory, total memory 4KB aligned to 4KB to preserve 12 zeros on end
+#define VGA_MEM_START   0xA0000     // legacy VGA memory, text mode and the spare terminal pages
+#define VGA_MEM_END     0xC0000
+
+#define IA32_PAT        0x277       // PAT MSR
+#define PAT_WC          0x01        // PAT memory type encodings
+#define PAT_WB          0x06
+#define PAT_UC_MINUS    0x07
+#define PAT_UC          0x00
+#define CPUID_PAT       (1 << 16)   // CPUID 1 EDX bit for PAT support
+
+
+// Boot page directory with the kernel's entries, total memory 4KB aligned to 4KB to preserve 12 zeros on end
 int32_t page_directory[KB_SIZE] __attribute__((aligned (4*KB_SIZE)));
 
 // Video page table, total memory 4KB aligned to 4KB to preserve 12 zeros on end
@@ -37,20 +53,53 @@ void init_paging();
 // Sets control registers to initialize paging 
 void set_paging_registers();
 
-// remove page of user process ending
-void remove_page(uint32_t virtual_addr);
+// Programs the PAT so CACHE_WC selects write-combining
+int32_t init_pat();
+
+// Memory type for a page of video memory or a terminal's backing page in RAM
+uint32_t video_cache_type(uint32_t physical_addr);
+
+// Sets up the page directory of a new process with the kernel's entries
+void init_page_directory(int32_t* directory);
+
+// Switch to the address space of a page directory
+void load_page_directory(int32_t* directory);
+
+// Drop the TLB entry of one page of the loaded address space
+void invalidate_page(uint32_t virtual_addr);
 
-// remove 4kb page
-void remove_4kb_page(uint32_t virtual_addr);
+// Point the 128MB user page of a page directory at the page table of a process
+void map_user_page_table(int32_t* directory, int32_t* table);
 
-// Set page table to point to new physical memory
-void map_virtual_addr_to_physical(uint32_t virtual_addr, uint32_t physical_addr);
+// Remove every page in the 128MB user page of a process
+void clear_user_page_table(int32_t* table);
 
-// Mark page for user program as present
-void map_virtual_addr_to_physical_4kb_page(uint32_t virtual_addr, uint32_t physical_addr);
+// Free the private frames mapped in the 128MB user page of a process
+uint32_t free_user_pages(int32_t* table);
+
+// Mark a 4kb user page as present in the 128MB user page of a process
+void map_user_4kb_page(int32_t* table, uint32_t virtual_addr, uint32_t physical_addr, int32_t writable, uint32_t cache);
+
+// copy a run of prepared page table entries into the 128MB user page of a process
+void load_user_page_entries(int32_t* table, uint32_t virtual_addr, const uint32_t* entries, uint32_t count);
+
+// Point the mmap window of a page directory at the page table of a process
+void map_mmap_page_table(int32_t* directory, int32_t* table);
+
+// Remove every page in the mmap window of a process
+void clear_mmap_page_table(int32_t* table);
+
+// Mark a read-only 4kb user page as present in the mmap window of a process
+void map_mmap_readonly_4kb_page(int32_t* table, uint32_t virtual_addr, uint32_t physical_addr, uint32_t cache);
 
 // Mark page for 4kb video page as present
-void map_terminal_vidmem(uint32_t virtual_addr, uint32_t physical_addr);
+void map_terminal_vidmem(uint32_t virtual_addr, uint32_t physical_addr, uint32_t cache);
+
+// Map the vidmap page of a terminal's processes in a page directory
+void map_vidmap_page_table(int32_t* directory, uint32_t terminal);
+
+// Point the vidmap page of a terminal's processes at physical memory
+void set_vidmap_page(uint32_t terminal, uint32_t physical_addr, uint32_t cache);
 
 #endif /* _PAGING_H */
 
@@ -1,40 +1,183 @@
 #include "pit.h"
 
-// static volatile int timer_ticks = 0;
-
-
-#define PIT_FREQ    1193180
+#define PIT_FREQ    1193182     // input clock, Hz
+#define PIT_COUNTS_PER_MS   1193
+#define PIT_MAX_COUNT   0xFFFF  // longest one-shot interval, about 55ms
 #define PIT_BITMASK 0xFF
 #define PIT_SHIFT   8
 #define PIT_CONTROL 0x43
 #define PIT_A       0x40
-#define PIT_SET     0x36
+#define PIT_SET     0x36        // channel 0, lobyte/hibyte, mode 3 square wave
+#define PIT_ONESHOT 0x30        // channel 0, lobyte/hibyte, mode 0 interrupt on terminal count
+#define PIT_READBACK    0xC2    // latch channel 0's status and count
+#define PIT_OUT         0x80    // status: output high, the count reached 0
+#define PIT_NULL_COUNT  0x40    // status: the count written hasn't been loaded yet
+
+#define PIT_COUNTS_TO_US(counts)    ((counts) * 1000 / PIT_COUNTS_PER_MS)
+#define PIT_US_TO_COUNTS(usecs)     ((usecs) * PIT_COUNTS_PER_MS / 1000)
+
+static uint32_t timer_mode = TIMER_PERIODIC;
+static uint32_t tick_us;        // microseconds between periodic ticks
+
+// clock at the last tick in periodic mode, at the last arm in one-shot mode
+static uint32_t timer_base_us;
+// one-shot interval counting down, 0 when the timer is stopped
+static uint32_t armed_counts;
+
+/** 
+ * parse_cmdline
+ * 
+ * Description: Reads the timer options from the kernel command line, "pit_hz=<rate>"
+ *              and "tickless"
+ * Inputs: cmdline - command line from the boot loader, NULL for none
+ *         hz - set to the rate asked for, left alone without pit_hz=
+ * Outputs: TIMER_ONESHOT if tickless is on the line, TIMER_PERIODIC if not
+ */
+static uint32_t parse_cmdline(const int8_t* cmdline, uint32_t* hz) {
+    uint32_t mode = TIMER_PERIODIC;
+    uint32_t value;
+
+    if (cmdline == NULL)
+        return mode;
+    while (*cmdline != '\0') {
+        if (strncmp(cmdline, (int8_t*)"pit_hz=", 7) == 0) {
+            cmdline += 7;
+            value = 0;
+            while (*cmdline >= '0' && *cmdline <= '9' && value <= PIT_MAX_HZ)
+                value = value * 10 + (*cmdline++ - '0');
+            *hz = value;
+        } else if (strncmp(cmdline, (int8_t*)"tickless", 8) == 0 && (cmdline[8] == ' ' || cmdline[8] == '\0')) {
+            mode = TIMER_ONESHOT;
+        }
+        // next word
+        while (*cmdline != ' ' && *cmdline != '\0')
+            cmdline++;
+        while (*cmdline == ' ')
+            cmdline++;
+    }
+    return mode;
+}
+
+/** 
+ * pit_program
+ * 
+ * Description: Loads a mode and a count into channel 0
+ * Inputs: mode - PIT_SET or PIT_ONESHOT
+ *         counts - divisor or interval in input clock cycles, 1 to PIT_MAX_COUNT
+ * Outputs: none
+ */
+static void pit_program(uint32_t mode, uint32_t counts) {
+    outb(mode, PIT_CONTROL);
+    outb(counts & PIT_BITMASK, PIT_A);
+    outb(counts >> PIT_SHIFT, PIT_A);
+}
 
 /** 
  * init_pit
  * 
- * Description: Initializes PIT 
- * Inputs: none
+ * Description: Initializes PIT at the rate on the kernel command line, PIT_DEFAULT_HZ without
+ *              one. Periodic mode interrupts every tick, one-shot mode only when the scheduler
+ *              has something due, starting with one tick for the first shells
+ * Inputs: cmdline - kernel command line, NULL for none
  * Outputs: none
  * Side Effects: Enables PIT, from OSDEV
  */
-void init_pit() {
-    outb(PIT_SET, PIT_CONTROL);
-    outb(PIT_FREQ & PIT_BITMASK, PIT_A);
-    outb(PIT_FREQ >> PIT_SHIFT, PIT_A);
+void init_pit(const int8_t* cmdline) {
+    uint32_t hz = PIT_DEFAULT_HZ;
+
+    timer_mode = parse_cmdline(cmdline, &hz);
+    if (hz < PIT_MIN_HZ || hz > PIT_MAX_HZ) {
+        printf("pit_hz=%u out of range, using %u\n", hz, PIT_DEFAULT_HZ);
+        hz = PIT_DEFAULT_HZ;
+    }
+    tick_us = 1000000 / hz;
+
+    if (timer_mode == TIMER_PERIODIC)
+        pit_program(PIT_SET, PIT_FREQ / hz);
+    else
+        timer_set_event(tick_us);
     enable_irq(0);              // enable master port 0
 }
 
+/** 
+ * timer_now
+ * 
+ * Description: Clock the scheduler charges time on. Periodic mode advances it a tick at a
+ *              time, one-shot mode reads how far the armed interval has counted down. It
+ *              stands still while the one-shot timer is stopped, nothing is waiting on it then
+ * Inputs: none
+ * Outputs: microseconds since boot, wraps after about 71 minutes
+ * Side Effects: Call with interrupts off
+ */
+uint32_t timer_now() {
+    uint32_t status, remaining;
+
+    if (timer_mode == TIMER_PERIODIC || armed_counts == 0)
+        return timer_base_us;
+
+    outb(PIT_READBACK, PIT_CONTROL);
+    status = inb(PIT_A);
+    remaining = inb(PIT_A);
+    remaining |= inb(PIT_A) << PIT_SHIFT;
+    if (status & PIT_NULL_COUNT)
+        return timer_base_us;
+    // past 0 the count wraps and keeps going, the output pin says it got there
+    if ((status & PIT_OUT) || remaining > armed_counts)
+        remaining = 0;
+    return timer_base_us + PIT_COUNTS_TO_US(armed_counts - remaining);
+}
+
+/** 
+ * timer_tick_us
+ * 
+ * Description: tick length getter
+ * Inputs: none
+ * Outputs: microseconds between periodic ticks, the shortest one-shot interval
+ */
+uint32_t timer_tick_us() {
+    return tick_us;
+}
+
+/** 
+ * timer_set_event
+ * 
+ * Description: Reprograms the one-shot timer for the scheduler's next event, no earlier than
+ *              a tick and no later than the PIT can count. A later interrupt after the event
+ *              is cheaper than a periodic tick, the scheduler arms again from it
+ * Inputs: usecs - microseconds from now, 0 to stop the timer
+ * Outputs: none
+ * Side Effects: Nothing in periodic mode. Call with interrupts off
+ */
+void timer_set_event(uint32_t usecs) {
+    if (timer_mode == TIMER_PERIODIC)
+        return;
+
+    // the time the old interval ran for stays on the clock
+    timer_base_us = timer_now();
+    if (usecs == 0) {
+        // mode 0 holds the count until one is written, no interrupt comes
+        armed_counts = 0;
+        outb(PIT_ONESHOT, PIT_CONTROL);
+        return;
+    }
+    if (usecs < tick_us)
+        usecs = tick_us;
+    armed_counts = usecs > PIT_COUNTS_TO_US(PIT_MAX_COUNT) ? PIT_MAX_COUNT : PIT_US_TO_COUNTS(usecs);
+    pit_program(PIT_ONESHOT, armed_counts);
+}
+
 /** 
  * pit_irq
  * 
  * Description: send eoi and call scheduling, this is called each PIT interrupt
  * Inputs: none
  * Outputs: none
- * Side Effects: Calls scheduler to implement round robin scheduling
+ * Side Effects: Calls the scheduler tick, which may switch tasks and arms the next one-shot
+ *               interrupt. The EOI goes first, the switched-to task doesn't come back here
  */
 void pit_irq() {
+    if (timer_mode == TIMER_PERIODIC)
+        timer_base_us += tick_us;
     send_eoi(0);
-    scheduler();
-    send_eoi(0);
+    scheduler_tick();
 }
@@ -6,10 +6,26 @@
 #include "system_call.h"
 #include "scheduler.h"
 
-// enable the pit
-void init_pit();
+#define PIT_DEFAULT_HZ  100         // tick rate without pit_hz= on the kernel command line
+#define PIT_MIN_HZ      19          // slowest rate whose divisor fits in 16 bits
+#define PIT_MAX_HZ      10000       // fastest rate, the interrupt overhead swamps the CPU past it
+
+#define TIMER_PERIODIC  0           // an interrupt every tick
+#define TIMER_ONESHOT   1           // an interrupt at the scheduler's next event, "tickless" on the command line
+
+// set up the timer from the kernel command line and enable the pit
+void init_pit(const int8_t* cmdline);
 
 // process the interrupt from irq
 void pit_irq();
 
+// microseconds the timer has counted since boot
+uint32_t timer_now();
+
+// microseconds between ticks, the finest interval the timer is programmed for
+uint32_t timer_tick_us();
+
+// in one-shot mode, interrupt after usecs, or never for 0
+void timer_set_event(uint32_t usecs);
+
 #endif
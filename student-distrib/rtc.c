@@ -1,11 +1,16 @@
 
 #include "rtc.h"
+#include "scheduler.h"
 
-// initialize rtc interrupt flag
-static volatile int32_t rtc_interrupt_flag = 0;
+// RTC interrupts since boot, readers sleep until it reaches their deadline
+static volatile uint32_t rtc_ticks = 0;
+
+// readers waiting for rtc_ticks to reach rtc_next_wake, the earliest of their deadlines
+static wait_queue_t rtc_queue;
+static uint32_t rtc_next_wake = 0;
+static int32_t rtc_sleepers = 0;
 
 static volatile int32_t terminal_rtc[NUM_TERMINALS] = {0, 0, 0};// terminal_rtc[3]
-static volatile int32_t rtc_counter[NUM_TERMINALS] = {0, 0, 0}; // rtc_counter[3]
 static int32_t rtc_initialized = 0;
 
 #define RTC_DATA    0x71
@@ -32,7 +37,6 @@ void init_rtc() {
     char prev = inb(RTC_DATA);          // read current val of reg B from rtc data port
     outb(RTC_REG_B, RTC_REG); 
     outb(prev | 0x40, RTC_DATA);        // write prev value ORed w/0x40, which sets bit 6 of register B
-    rtc_interrupt_flag = 0;
 }
 
 /** 
@@ -53,7 +57,16 @@ void rtc_irq() {
     // sti();                          so that another interrupt can occur. if you don't read, then no more rtc
                                     // interrupts can happen
     send_eoi(8);                    // send eoi of slave 0
-    rtc_interrupt_flag = 1;
+    rtc_ticks++;
+
+    // only wake the readers once the earliest of them is due, they go back to sleep
+    // with the next deadline
+    if (rtc_sleepers && (int32_t)(rtc_ticks - rtc_next_wake) >= 0) {
+        rtc_sleepers = 0;
+        wake_up(&rtc_queue);
+        // a real-time reader gets the CPU now rather than at the next PIT tick
+        sched_preempt_check();
+    }
     
 }
 
@@ -145,23 +158,24 @@ int32_t RTC_open(int fd, const uint8_t* filename){
 
 /** 
  * RTC_read
- * Description: Waits for an RTC interrupt to occur, then returns
+ * Description: Waits for the terminal's virtual RTC period, sleeping between interrupts
  * Inputs: fd, buf, nbytes
  * Outputs: return 0 on success
- * Side Effects: Increments counter for test cases
+ * Side Effects: Blocks the calling task until its deadline
  */
 int32_t RTC_read(int32_t fd, void* buf, int32_t nbytes){
-    rtc_interrupt_flag = 0;
-	rtc_counter[getExecuteTerm()] = 0;
-	while(rtc_counter[getExecuteTerm()] < terminal_rtc[getExecuteTerm()]/2) {			// wait for interrupt
-		while (!rtc_interrupt_flag);				// terminal_rtc[terminal_num]
-        rtc_interrupt_flag = 0;
-		rtc_counter[getExecuteTerm()]++;
-    	// count++;                                // increment count and reset interrupt flag
-
+    uint32_t flags;
+    uint32_t deadline = rtc_ticks + terminal_rtc[getExecuteTerm()]/2;		// terminal_rtc[terminal_num]
+
+    cli_and_save(flags);
+    while ((int32_t)(rtc_ticks - deadline) < 0) {
+        if (!rtc_sleepers || (int32_t)(deadline - rtc_next_wake) < 0)
+            rtc_next_wake = deadline;
+        rtc_sleepers = 1;
+        sleep_on(&rtc_queue);
     }
-	// printf("%x, %x, %x", rtc_counter, rt)
-    
+    restore_flags(flags);
+
     return 0; 								// return 0 when an interrupt happens
 }
 
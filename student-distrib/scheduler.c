@@ -1,18 +1,659 @@
 #include "scheduler.h"
+#include "pit.h"
 
-int32_t terminal_esp[NUM_TERMINALS];
-int32_t terminal_ebp[NUM_TERMINALS];
+// runnable tasks of each MLFQ level in the order they get the CPU, the running task is never on them
+static pcb_t* run_queue_heads[MLFQ_LEVELS];
+static pcb_t* run_queue_tails[MLFQ_LEVELS];
+static uint32_t run_queue_levels;      // bit per level with a runnable task
+
+// runnable real-time tasks with budget left, earliest deadline first, served ahead of the MLFQ
+static pcb_t* rt_queue;
+// every real-time task, linked through rt_next, and the per mille of the CPU they reserve
+static pcb_t* rt_tasks;
+static uint32_t rt_util;
+
+// timer_now when tasks were last charged, real-time periods and deadlines are counted on it
+static uint32_t sched_clock;
+
+// microseconds until every task is lifted back to its nice level
+static uint32_t boost_left = MLFQ_BOOST_US;
+
+// task on the CPU, NULL before the first shell
+static pcb_t* current_task;
+
+// runs hlt when nothing else is runnable, started the first time it is needed
+static pcb_t idle_task = { .state = TASK_IDLE };
+static uint32_t idle_stack[KERNEL_STACK_SIZE / sizeof(uint32_t)];
+static int32_t idle_started = 0;
+
+/** 
+ * effective_level
+ * 
+ * Description: Level a task is queued at, its MLFQ level lifted by one on the displayed
+ *              terminal so keystrokes are echoed ahead of background work
+ * Inputs: task - task to place
+ * Outputs: run queue level, 0 is the highest priority
+ */
+static int32_t effective_level(pcb_t* task) {
+    if (task->terminal == getDisplayTerm() && task->level > 0)
+        return task->level - 1;
+    return task->level;
+}
+
+/** 
+ * deadline_before
+ * 
+ * Description: Compares two deadlines on the sched_clock, correct across its wrap
+ * Inputs: a, b - deadlines
+ * Outputs: 1 if a is earlier than b, 0 if not
+ */
+static int32_t deadline_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+/** 
+ * rt_queue_add
+ * 
+ * Description: Inserts a real-time task into the EDF queue behind every task whose deadline
+ *              isn't later, so equal deadlines take turns
+ * Inputs: task - real-time task with budget left that isn't on a run queue
+ * Outputs: none
+ * Side Effects: Call with interrupts off
+ */
+static void rt_queue_add(pcb_t* task) {
+    pcb_t* prev = NULL;
+    pcb_t* next = rt_queue;
+
+    while (next != NULL && !deadline_before(task->rt_deadline, next->rt_deadline)) {
+        prev = next;
+        next = next->run_next;
+    }
+    task->run_level = RT_LEVEL;
+    task->run_prev = prev;
+    task->run_next = next;
+    if (prev != NULL)
+        prev->run_next = task;
+    else
+        rt_queue = task;
+    if (next != NULL)
+        next->run_prev = task;
+}
+
+/** 
+ * rt_util_of
+ * 
+ * Description: Share of the CPU a period and budget reserve, rounded up
+ * Inputs: period, budget - microseconds, period at least RT_MIN_PERIOD and budget no more than it
+ * Outputs: per mille of the CPU
+ */
+static uint32_t rt_util_of(uint32_t period, uint32_t budget) {
+    uint32_t period_ms = period / 1000;
+
+    return (budget + period_ms - 1) / period_ms;
+}
+
+/** 
+ * run_queue_add
+ * 
+ * Description: Puts a task at the tail of the run queue of its level, or into the EDF
+ *              queue by deadline while it is a real-time task with budget left
+ * Inputs: task - task that isn't on the run queue
+ * Outputs: none
+ * Side Effects: Marks the task TASK_RUNNABLE. Call with interrupts off
+ */
+void run_queue_add(pcb_t* task) {
+    int32_t level = effective_level(task);
+
+    task->state = TASK_RUNNABLE;
+    if (task->rt_budget_left > 0) {
+        rt_queue_add(task);
+        return;
+    }
+    task->run_level = level;
+    task->run_next = NULL;
+    task->run_prev = run_queue_tails[level];
+    if (run_queue_tails[level] != NULL)
+        run_queue_tails[level]->run_next = task;
+    else
+        run_queue_heads[level] = task;
+    run_queue_tails[level] = task;
+    run_queue_levels |= 1 << level;
+}
+
+/** 
+ * run_queue_remove
+ * 
+ * Description: Takes a task off the run queue wherever it is
+ * Inputs: task - task on the run queue
+ * Outputs: none
+ * Side Effects: Unlinks the task. Call with interrupts off
+ */
+void run_queue_remove(pcb_t* task) {
+    int32_t level = task->run_level;
+
+    if (level == RT_LEVEL) {
+        if (task->run_prev != NULL)
+            task->run_prev->run_next = task->run_next;
+        else
+            rt_queue = task->run_next;
+        if (task->run_next != NULL)
+            task->run_next->run_prev = task->run_prev;
+        task->run_prev = NULL;
+        task->run_next = NULL;
+        return;
+    }
+
+    if (task->run_prev != NULL)
+        task->run_prev->run_next = task->run_next;
+    else
+        run_queue_heads[level] = task->run_next;
+    if (task->run_next != NULL)
+        task->run_next->run_prev = task->run_prev;
+    else
+        run_queue_tails[level] = task->run_prev;
+    if (run_queue_heads[level] == NULL)
+        run_queue_levels &= ~(1 << level);
+    task->run_prev = NULL;
+    task->run_next = NULL;
+}
+
+/** 
+ * run_queue_pop
+ * 
+ * Description: Takes the real-time task with the earliest deadline, or else the task at the
+ *              head of the highest priority level with a runnable task, found with one bit
+ *              scan of run_queue_levels
+ * Inputs: none
+ * Outputs: the task, NULL if nothing is runnable
+ * Side Effects: Unlinks the task. Call with interrupts off
+ */
+pcb_t* run_queue_pop() {
+    pcb_t* task;
+
+    if (rt_queue != NULL) {
+        task = rt_queue;
+        run_queue_remove(task);
+        return task;
+    }
+    if (run_queue_levels == 0)
+        return NULL;
+    task = run_queue_heads[__builtin_ctz(run_queue_levels)];
+    run_queue_remove(task);
+    return task;
+}
+
+/** 
+ * sched_init_task
+ * 
+ * Description: Starts a new task at the top level it is allowed, with its parent's nice value.
+ *              It starts best-effort, a real-time parent's reservation isn't inherited
+ * Inputs: task - new task
+ *         parent - task it was executed from, NULL for a terminal's first shell
+ * Outputs: none
+ */
+void sched_init_task(pcb_t* task, pcb_t* parent) {
+    task->nice = parent != NULL ? parent->nice : 0;
+    task->level = task->nice;
+    task->quantum_left = MLFQ_QUANTUM_US(task->level);
+    task->rt_period = 0;
+    task->rt_budget = 0;
+    task->rt_budget_left = 0;
+    task->rt_next = NULL;
+}
+
+/** 
+ * set_task_nice
+ * 
+ * Description: Changes the nice value of a task, the best level it can reach
+ * Inputs: task - task to change
+ *         increment - added to its nice value, which is kept between 0 and MLFQ_LEVELS - 1
+ * Outputs: the new nice value
+ * Side Effects: Drops the task to its new nice level if it was above it
+ */
+int32_t set_task_nice(pcb_t* task, int32_t increment) {
+    int32_t nice = task->nice + increment;
+
+    if (nice < 0)
+        nice = 0;
+    if (nice > MLFQ_LEVELS - 1)
+        nice = MLFQ_LEVELS - 1;
+    task->nice = nice;
+    if (task->level < nice)
+        task->level = nice;
+    return nice;
+}
+
+/** 
+ * set_task_periodic
+ * 
+ * Description: Makes a task real-time, given budget microseconds of CPU ahead of every best-effort
+ *              task in each period, earliest deadline first. Admission control keeps the
+ *              reservations of all real-time tasks within RT_MAX_UTIL, so every budget can
+ *              be met and the MLFQ still gets the rest of the CPU
+ * Inputs: task - running task to change
+ *         period - microseconds between releases, RT_MIN_PERIOD to RT_MAX_PERIOD, 0 to go
+ *                  back to best-effort
+ *         budget - microseconds of CPU each period, 1 to period
+ * Outputs: 0 on success, -1 for a bad period or budget or when the CPU is already reserved
+ * Side Effects: A new reservation starts its first period now with a full budget.
+ *               Call with interrupts off
+ */
+int32_t set_task_periodic(pcb_t* task, uint32_t period, uint32_t budget) {
+    uint32_t util = 0;
+    uint32_t old_util = 0;
+    pcb_t** link;
+
+    if (period > RT_MAX_PERIOD)
+        return -1;
+    if (period != 0) {
+        if (period < RT_MIN_PERIOD || budget == 0 || budget > period)
+            return -1;
+        util = rt_util_of(period, budget);
+    }
+    if (task->rt_period != 0)
+        old_util = rt_util_of(task->rt_period, task->rt_budget);
+    if (rt_util - old_util + util > RT_MAX_UTIL)
+        return -1;
+    rt_util = rt_util - old_util + util;
+
+    if (period == 0) {
+        // unlink from the real-time tasks, it runs on its MLFQ level from now on
+        for (link = &rt_tasks; *link != NULL; link = &(*link)->rt_next) {
+            if (*link == task) {
+                *link = task->rt_next;
+                break;
+            }
+        }
+        task->rt_next = NULL;
+    } else if (task->rt_period == 0) {
+        task->rt_next = rt_tasks;
+        rt_tasks = task;
+    }
+    task->rt_period = period;
+    task->rt_budget = budget;
+    task->rt_budget_left = budget;
+    task->rt_deadline = sched_clock + period;
+    return 0;
+}
+
+/** 
+ * sched_exit_task
+ * 
+ * Description: Gives back a halting task's real-time reservation
+ * Inputs: task - running task that is halting
+ * Outputs: none
+ * Side Effects: Call with interrupts off
+ */
+void sched_exit_task(pcb_t* task) {
+    if (task->rt_period != 0)
+        set_task_periodic(task, 0, 0);
+}
+
+/** 
+ * release_rt_tasks
+ * 
+ * Description: Starts the next period of every real-time task whose deadline has come, with
+ *              a full budget and the deadline one period on. A task that slept through whole
+ *              periods starts a fresh one from now
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Moves runnable released tasks into the EDF queue. Call with interrupts off
+ */
+static void release_rt_tasks() {
+    pcb_t* task;
+
+    for (task = rt_tasks; task != NULL; task = task->rt_next) {
+        if (deadline_before(sched_clock, task->rt_deadline))
+            continue;
+        task->rt_deadline += task->rt_period;
+        if (!deadline_before(sched_clock, task->rt_deadline))
+            task->rt_deadline = sched_clock + task->rt_period;
+        task->rt_budget_left = task->rt_budget;
+        if (task->state == TASK_RUNNABLE) {
+            run_queue_remove(task);
+            run_queue_add(task);
+        }
+    }
+}
+
+/** 
+ * rt_preempts
+ * 
+ * Description: Whether the EDF queue should take the CPU from a task, when it is best-effort
+ *              or a real-time task with a later deadline
+ * Inputs: task - running task
+ * Outputs: 1 to switch, 0 to keep running
+ */
+static int32_t rt_preempts(pcb_t* task) {
+    if (rt_queue == NULL)
+        return 0;
+    return task->rt_budget_left == 0 || deadline_before(rt_queue->rt_deadline, task->rt_deadline);
+}
+
+/** 
+ * boost_tasks
+ * 
+ * Description: Lifts every runnable task back to its nice level, so CPU bound work on a
+ *              hidden terminal isn't starved by a busy displayed one
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Requeues the runnable tasks. Call with interrupts off
+ */
+static void boost_tasks() {
+    pcb_t* boosted = NULL;
+    pcb_t* task;
+
+    while ((task = run_queue_pop()) != NULL) {
+        task->level = task->nice;
+        task->quantum_left = MLFQ_QUANTUM_US(task->level);
+        task->run_next = boosted;
+        boosted = task;
+    }
+    // requeued in reverse, which only reorders tasks that were at different levels
+    while (boosted != NULL) {
+        task = boosted;
+        boosted = boosted->run_next;
+        run_queue_add(task);
+    }
+    if (current_task != NULL && current_task->state == TASK_RUNNING)
+        current_task->level = current_task->nice;
+}
+
+/** 
+ * sched_account
+ * 
+ * Description: Charges the time since the last call to the running task, its real-time
+ *              budget while it has one and its MLFQ quantum otherwise, then releases the
+ *              real-time periods and runs the priority boost that came due
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Advances sched_clock to timer_now. Call with interrupts off
+ */
+static void sched_account() {
+    uint32_t now = timer_now();
+    uint32_t elapsed = now - sched_clock;
+    pcb_t* task = current_task;
+
+    sched_clock = now;
+    if (task != NULL && task != &idle_task) {
+        if (task->rt_budget_left > 0)
+            task->rt_budget_left -= elapsed < task->rt_budget_left ? elapsed : task->rt_budget_left;
+        else
+            task->quantum_left -= elapsed < task->quantum_left ? elapsed : task->quantum_left;
+    }
+    release_rt_tasks();
+
+    if (boost_left <= elapsed) {
+        boost_left = MLFQ_BOOST_US;
+        boost_tasks();
+    } else {
+        boost_left -= elapsed;
+    }
+}
+
+/** 
+ * earlier_event
+ * 
+ * Description: The sooner of two scheduler events
+ * Inputs: next - microseconds to the earliest event so far, 0 for none
+ *         usecs - microseconds to another event, 0 if it is due now
+ * Outputs: microseconds to the sooner one, at least 1
+ */
+static uint32_t earlier_event(uint32_t next, uint32_t usecs) {
+    if (usecs == 0)
+        usecs = 1;
+    return (next == 0 || usecs < next) ? usecs : next;
+}
+
+/** 
+ * sched_next_event
+ * 
+ * Description: When scheduler_tick next has something to do: the running task's quantum or
+ *              budget running out, a real-time release, the priority boost while tasks wait
+ *              for the CPU, or right away when a runnable task should preempt. Nothing is due
+ *              while the idle task runs without real-time tasks
+ * Inputs: none
+ * Outputs: microseconds after sched_clock, 0 for no event
+ */
+static uint32_t sched_next_event() {
+    pcb_t* task = current_task;
+    pcb_t* rt;
+    uint32_t next = 0;
+
+    // the first shells are started one per tick
+    if (task == NULL || pid < NUM_TERMINALS - 1)
+        return timer_tick_us();
+
+    for (rt = rt_tasks; rt != NULL; rt = rt->rt_next)
+        next = earlier_event(next, rt->rt_deadline - sched_clock);
+    if (task == &idle_task)
+        return next;
+
+    if (task->rt_budget_left > 0) {
+        if (rt_preempts(task))
+            return 1;
+        next = earlier_event(next, task->rt_budget_left);
+    } else {
+        if (rt_preempts(task) || (run_queue_levels & ((1 << effective_level(task)) - 1)))
+            return 1;
+        next = earlier_event(next, task->quantum_left);
+    }
+    if (run_queue_levels != 0 || rt_queue != NULL)
+        next = earlier_event(next, boost_left);
+    return next;
+}
+
+/** 
+ * sched_set_timer
+ * 
+ * Description: Arms the one-shot timer for the scheduler's next event, so a task running
+ *              alone or an idle CPU take no interrupts until something is due
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Reprograms the PIT in one-shot mode. Call with interrupts off
+ */
+static void sched_set_timer() {
+    uint32_t next = sched_next_event();
+    uint32_t since;
+
+    // events count from the last charge, some of that time has already gone by
+    if (next != 0) {
+        since = timer_now() - sched_clock;
+        next = next > since ? next - since : 1;
+    }
+    timer_set_event(next);
+}
+
+/** 
+ * get_current_task
+ * 
+ * Description: running task getter
+ * Inputs: none
+ * Outputs: the running task, NULL before the first shell
+ */
+pcb_t* get_current_task() {
+    return current_task;
+}
+
+/** 
+ * set_current_task
+ * 
+ * Description: running task setter, for execute and halt handing the CPU from parent to child
+ *              and back without going through the run queue
+ * Inputs: task - new running task
+ * Outputs: none
+ */
+void set_current_task(pcb_t* task) {
+    current_task = task;
+}
+
+/** 
+ * sleep_on
+ * 
+ * Description: Blocks the running task on a wait queue and gives the CPU away. Callers
+ *              check their condition in a loop around it, with interrupts off so a wakeup
+ *              can't slip in between the check and the sleep
+ * Inputs: queue - wait queue to sleep on
+ * Outputs: none
+ * Side Effects: Returns once wake_up ran and the scheduler picked the task again,
+ *               interrupts still off
+ */
+void sleep_on(wait_queue_t* queue) {
+    pcb_t* task = current_task;
+
+    // no task to put to sleep before the first shell, wait for the next interrupt instead
+    if (task == NULL || task == &idle_task) {
+        asm volatile ("sti; hlt; cli");
+        return;
+    }
+
+    task->state = TASK_SLEEPING;
+    task->run_next = NULL;
+    task->run_prev = queue->tail;
+    if (queue->tail != NULL)
+        queue->tail->run_next = task;
+    else
+        queue->head = task;
+    queue->tail = task;
+
+    scheduler();
+}
+
+/** 
+ * wake_up
+ * 
+ * Description: Moves every task sleeping on a wait queue to the run queue, in the order
+ *              they went to sleep
+ * Inputs: queue - wait queue to empty
+ * Outputs: none
+ * Side Effects: Call with interrupts off, from an interrupt handler or a system call.
+ *               The woken tasks run at their turn, an idle CPU picks them up right away
+ */
+void wake_up(wait_queue_t* queue) {
+    pcb_t* task = queue->head;
+    pcb_t* next;
+
+    queue->head = NULL;
+    queue->tail = NULL;
+    while (task != NULL) {
+        next = task->run_next;
+        // blocking before the quantum ran out earns a level and a fresh, shorter quantum
+        if (task->level > task->nice)
+            task->level--;
+        task->quantum_left = MLFQ_QUANTUM_US(task->level);
+        run_queue_add(task);
+        task = next;
+    }
+    // in one-shot mode a woken task that should preempt brings the next interrupt forward
+    sched_set_timer();
+}
+
+/** 
+ * idle
+ * 
+ * Description: Body of the idle task, halts until an interrupt makes a task runnable
+ * Inputs: none
+ * Outputs: none, never returns
+ * Side Effects: sti; hlt, the interrupt shadow of sti keeps a wakeup from landing between them
+ */
+static void idle() {
+    while (1) {
+        cli();
+        if (run_queue_levels != 0 || rt_queue != NULL)
+            scheduler();
+        asm volatile ("sti; hlt");
+    }
+}
+
+/** 
+ * sched_preempt_check
+ * 
+ * Description: Lets a real-time task an interrupt handler just woke run right away instead
+ *              of at the next PIT tick, which bounds its wakeup latency by the handler
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Calls scheduler from the interrupt handler, after its EOI
+ */
+void sched_preempt_check() {
+    pcb_t* task = current_task;
+
+    // the idle task picks up woken tasks itself, the first shells are started by the PIT
+    if (task == NULL || task == &idle_task || pid < NUM_TERMINALS - 1)
+        return;
+    if (rt_preempts(task))
+        scheduler();
+}
+
+/** 
+ * scheduler_tick
+ * 
+ * Description: Scheduling bookkeeping for each timer interrupt. The time since the last one
+ *              is charged, then a real-time task keeps the CPU until its budget is used up or
+ *              an earlier deadline is runnable. Otherwise MLFQ, a task that uses up its
+ *              quantum sinks a level to a longer one and goes to the back of its queue, a
+ *              task with quantum left keeps the CPU unless a higher level or real-time task
+ *              is runnable
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: Calls scheduler when the running task should be switched out, otherwise
+ *               arms the timer for the next event
+ */
+void scheduler_tick() {
+    pcb_t* task = current_task;
+
+    sched_account();
+
+    // the terminals' first shells are started by the scheduler, one each tick
+    if (task == NULL || task == &idle_task || pid < NUM_TERMINALS - 1) {
+        sched_set_timer();
+        scheduler();
+        return;
+    }
+
+    // real-time task, out of budget it goes back to its MLFQ level until its next release
+    if (task->rt_budget_left > 0 || task->run_level == RT_LEVEL) {
+        if (task->rt_budget_left == 0 || rt_preempts(task))
+            scheduler();
+        else
+            sched_set_timer();
+        return;
+    }
+    if (rt_preempts(task)) {
+        scheduler();
+        return;
+    }
+
+    if (task->quantum_left == 0) {
+        if (task->level < MLFQ_LEVELS - 1)
+            task->level++;
+        task->quantum_left = MLFQ_QUANTUM_US(task->level);
+        scheduler();
+    } else if (run_queue_levels & ((1 << effective_level(task)) - 1)) {
+        scheduler();
+    } else {
+        sched_set_timer();
+    }
+}
 
 /** 
  * scheduler
  * 
- * Description: Implements round robin scheduling, switch to next execute terminal
+ * Description: Switches to the real-time task with the earliest deadline, or the next task of
+ *              the highest MLFQ level. The running task goes to the tail of its level, round
+ *              robin within a level. Tasks blocked in execute or sleeping on a wait queue aren't
+ *              on the queue, and the idle task runs when it is empty. Called from the timer
+ *              tick, sleep_on and the idle task, with interrupts off
  * Inputs: none
  * Outputs: none
- * Side Effects: Context switch to next program kernel stack
+ * Side Effects: Context switch to next task's kernel stack, the timer is armed for its
+ *               next event
  */
 void scheduler() {
-    // Save user context (esp, ebp)
+	pcb_t* prev = current_task;
+	pcb_t* next;
+	uint32_t esp, ebp;
+
+    // Save kernel context (esp, ebp) of the task being switched out
 	// context switch (switching esp ebp to next kernel stack)
 
 	//esential to save esp, ebp first
@@ -20,9 +661,17 @@ void scheduler() {
 		"	movl %%esp, %0		\n	\
 			movl %%ebp, %1		\n 	\
 		"
-		: "=rm"(terminal_esp[getExecuteTerm()]), "=rm"(terminal_ebp[getExecuteTerm()])
+		: "=rm"(esp), "=rm"(ebp)
 		: // no inputs
 	);
+	// charge the time prev ran before it goes back on the queue
+	sched_account();
+	if (prev != NULL) {
+		prev->esp = esp;
+		prev->ebp = ebp;
+		if (prev->state == TASK_RUNNING)
+			run_queue_add(prev);
+	}
 	if (pid == -1) {
 		change_display_terminal(2);		//execute first terminal, only done once
 		ATTRIB = colors[2]; // pretty color number 2
@@ -61,24 +710,42 @@ void scheduler() {
 	}
 	
 
-	//increment execute terminal
-	setExecuteTerm((getExecuteTerm() + 1) % NUM_TERMINALS);
+	// head of the highest level, the task just switched out if it is alone
+	next = run_queue_pop();
+	if (next == NULL) {
+		// nothing runnable, the CPU idles until an interrupt wakes a task
+		if (prev == NULL || prev == &idle_task)
+			return;
+		current_task = &idle_task;
+		sched_set_timer();
+		load_page_directory(page_directory);
+		if (!idle_started) {
+			// first run of the idle task, on its own stack
+			idle_started = 1;
+			asm volatile (
+			"	movl %0, %%esp		\n	\
+				xorl %%ebp, %%ebp	\n	\
+				call *%1			\n	\
+			"
+			: // no outputs
+			: "r"(&idle_stack[KERNEL_STACK_SIZE / sizeof(uint32_t)]), "r"(idle)
+			);
+		}
+		next = &idle_task;
+	} else {
+		next->state = TASK_RUNNING;
+		current_task = next;
+		sched_set_timer();
+		setExecuteTerm(next->terminal);
 
-	// enable paging for current program 
-	map_virtual_addr_to_physical(USER_MEM_START, USER_PHYS_MEM_START + (getExecuteTerm() * USER_MEM_SIZE) + (terminal_process_num[getExecuteTerm()] * NUM_TERMINALS * USER_MEM_SIZE));
+		// switch to the address space of the scheduled process, its vidmap page follows
+		// its terminal and the kernel's global pages stay in the TLB
+		load_page_directory(next->page_directory);
 
-	// remap paging for video mem based on display and executing terminal
-	uint32_t video_phys_mem = VIDEO;
-	if (getDisplayTerm() != getExecuteTerm()) {
-		video_phys_mem = terminal_vidmem[getExecuteTerm()];	
+		// set TSS for scheduled process
+		tss.ss0 = KERNEL_DS;
+		tss.esp0 = getKernelStack();
 	}
-	
-	// remap video memory to appropriate memory location
-	map_virtual_addr_to_physical_4kb_page(USER_MEM_START+USER_MEM_SIZE, video_phys_mem);
-
-	// set TSS for scheduled process
-	tss.ss0 = KERNEL_DS;
-    tss.esp0 = USER_PHYS_MEM_START - KERNEL_STACK_SIZE*(getExecuteTerm()+1) - (terminal_process_num[getExecuteTerm()]) * NUM_TERMINALS * KERNEL_STACK_SIZE - 4; // 4 to account for ebp
 
 	// set esp ebp for next program, return to  it
 	asm volatile(
@@ -86,7 +753,7 @@ void scheduler() {
 		movl %1, %%ebp		\n 	\
 	"
 	: // no outputs
-	: "rm"(terminal_esp[getExecuteTerm()]), "rm"(terminal_ebp[getExecuteTerm()])
+	: "rm"(next->esp), "rm"(next->ebp)
 	);
 	return;
 }
@@ -3,7 +3,61 @@
 
 #include "system_call.h"
 
-// round robin to switch execute terminal each PIT interrupt
+#define MLFQ_LEVELS         3       // scheduling levels, 0 is the highest priority
+#define MLFQ_QUANTUM_US(level) (10000 << (level))   // microseconds a task runs at a level, longer further down
+#define MLFQ_BOOST_US       1000000 // microseconds between lifting every task back to its nice level
+
+#define RT_LEVEL            -1      // run_level of a task on the EDF queue
+#define RT_MAX_UTIL         900     // per mille of the CPU real-time tasks may reserve
+#define RT_MIN_PERIOD       1000    // microseconds
+#define RT_MAX_PERIOD       60000000    // microseconds, one minute
+
+// tasks sleeping until an interrupt handler wakes them
+typedef struct wait_queue_t {
+    pcb_t* head;
+    pcb_t* tail;
+} wait_queue_t;
+
+// switch to the next task of the highest level
 void scheduler();
 
+// scheduling accounting for each timer interrupt
+void scheduler_tick();
+
+// start a new task at its parent's nice level
+void sched_init_task(pcb_t* task, pcb_t* parent);
+
+// change a task's nice value, returns the new one
+int32_t set_task_nice(pcb_t* task, int32_t increment);
+
+// move a task into the periodic real-time class, or out of it with a period of 0
+int32_t set_task_periodic(pcb_t* task, uint32_t period, uint32_t budget);
+
+// take a halting task out of the scheduler's lists
+void sched_exit_task(pcb_t* task);
+
+// switch right away if an interrupt woke a task that should preempt the running one
+void sched_preempt_check();
+
+// block the running task on a wait queue until wake_up
+void sleep_on(wait_queue_t* queue);
+
+// move every task on a wait queue to the run queue
+void wake_up(wait_queue_t* queue);
+
+// put a task at the tail of the run queue
+void run_queue_add(pcb_t* task);
+
+// take a task off the run queue
+void run_queue_remove(pcb_t* task);
+
+// take the task at the head of the highest level, NULL if nothing is runnable
+pcb_t* run_queue_pop();
+
+// running task getter
+pcb_t* get_current_task();
+
+// running task setter, for execute and halt
+void set_current_task(pcb_t* task);
+
 #endif
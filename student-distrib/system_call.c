@@ -1,4 +1,5 @@
 #include "system_call.h"
+#include "scheduler.h"
 
 
 // keep track of current process
@@ -32,6 +33,17 @@ int volatile cur_execute_terminal = 0;
 // keep track of pid for each terminal
 int32_t terminal_process_num[NUM_TERMINALS] = {-1, -1, -1};
 
+// top process of each terminal, NULL before the terminal's first shell
+static pcb_t* terminal_pcbs[NUM_TERMINALS];
+
+// slab caches for the pcb, kernel stack and 4kb page tables of every process
+static kmem_cache_t* pcb_cache;
+static kmem_cache_t* kernel_stack_cache;
+static kmem_cache_t* page_table_cache;
+
+static void free_process(pcb_t* pcb, int32_t free_stack);
+static int32_t execute_process(const uint8_t * command, uint32_t kernel_stack);
+
 
 /** 
  * system_call_handler
@@ -64,13 +76,26 @@ void system_call_handler(int system_call_num) {
  */
 int32_t halt(uint8_t status) {
 	int32_t new_status = (int32_t) status;			// cast status to 32 bits
-    
+	pcb_t* pcb = getPCB();		// get current pcb
+	int32_t i;
+
+	for (i = FDA_MIN_INDEX; i < FDA_MAX_OF; i++) {	// Close all files associated with pcb, while it is still current
+        close(i);
+	}
+
     // Instead of pid this should probably be terminal_process_num[cur_execute_terminal]
 	if (terminal_process_num[cur_execute_terminal] == 0) {									// if closing last process, restart shell
+        // the new shell reuses the kernel stack this call runs on, nothing else may run on it meanwhile
+        uint32_t kernel_stack = pcb->kernel_stack;
+        cli();
+        sched_exit_task(pcb);
+        load_page_directory(page_directory);
+        terminal_pcbs[cur_execute_terminal] = NULL;
+        set_current_task(NULL);
+        free_process(pcb, 0);
 		pid--;
-		// decrement terminal pid or something
         terminal_process_num[cur_execute_terminal]--;
-        execute((uint8_t *) "shell");
+        execute_process((uint8_t *) "shell", kernel_stack);
 		return 0;
 	}
 
@@ -79,45 +104,32 @@ int32_t halt(uint8_t status) {
 
     exception_flag = 0;
 
-	pcb_t* pcb = getPCB();		// get current pcb
-    
-	int32_t i;
+    // once the parent is current this still runs on the child's stack, a tick would save that
+    // stack into the parent's context. Interrupts stay off until the jump to the parent's stack
+    cli();
+
 	pid--;
     terminal_process_num[cur_execute_terminal]--;
+    terminal_pcbs[cur_execute_terminal] = pcb->parent;
 
-    
-	for (i = FDA_MIN_INDEX; i < FDA_MAX_OF; i++) {	// Tear down current pcb
-        // Close all files associated with pcb
-        close(i);
-        pcb->fda[i].fops = NULL;
-        pcb->fda[i].inode = -1;
-        pcb->fda[i].file_position = -1;
-        pcb->fda[i].flags = 0;	
-	}
-
-	// 128 MB is the virtual address of the current user program
-	remove_page(USER_MEM_START);						// disable current process page
+    // the parent picks up where it blocked, on this time slice
+    pcb->parent->state = TASK_RUNNING;
+    set_current_task(pcb->parent);
 
-    // Unmap current video memory
-    remove_4kb_page(USER_MEM_START + USER_MEM_SIZE);
-	
-	// add flag to check for status (i.e. if exception was generated, want to squash user program)
-	
-	flush_tlb();
-    // Restore parent page, pid has already been decremented
-    map_virtual_addr_to_physical(USER_MEM_START, USER_PHYS_MEM_START + (cur_execute_terminal * USER_MEM_SIZE) + terminal_process_num[cur_execute_terminal] * NUM_TERMINALS * USER_MEM_SIZE);
+    // Restore parent address space, the parent is already the terminal's top process.
+    // This process's 128MB page, vidmap page and mmap window go with its directory
+    load_page_directory(getPCB()->page_directory);
 
 	tss.ss0 = KERNEL_DS;
-    tss.esp0 = USER_PHYS_MEM_START - KERNEL_STACK_SIZE*(cur_execute_terminal+1) - (terminal_process_num[cur_execute_terminal]) * NUM_TERMINALS * KERNEL_STACK_SIZE - 4;					// update tss, -4 for ebp
+    tss.esp0 = getKernelStack();					// update tss
 
 	uint32_t parent_ebp = pcb->parent_ebp;
 	uint32_t parent_esp = pcb->parent_esp;
 
-    // reset pcb
-    pcb->pid = -1;
-	pcb->parent_pid = -1;
-	pcb->parent_esp = 0;
-	pcb->parent_ebp = 0;
+    // the pcb and the kernel stack still under us are freed with interrupts off, so nothing
+    // can reuse them before the jump to the parent's stack
+    sched_exit_task(pcb);
+    free_process(pcb, 1);
 
     // ((terminal_t *)terminal_data[cur_execute_terminal])->_buffer_loc = 0;
 
@@ -144,15 +156,69 @@ int32_t halt(uint8_t status) {
  * Outputs: return value from executed program
  */
 int32_t execute(const uint8_t * command) {
+    return execute_process(command, 0);
+}
+
+/** 
+ * alloc_process
+ * 
+ * Description: Allocates a zeroed pcb with the page directory and tables and kernel stack of a new
+ *              process, its user pages are faulted in later
+ * Inputs: kernel_stack - kernel stack to reuse, 0 to allocate one
+ * Outputs: the pcb, NULL if memory is full
+ * Side Effects: Allocates from the process caches
+ */
+static pcb_t* alloc_process(uint32_t kernel_stack) {
+    pcb_t* pcb = kmem_cache_alloc(pcb_cache);
+    if (pcb == NULL)
+        return NULL;
+    memset(pcb, 0, sizeof(pcb_t));
+    pcb->page_directory = kmem_cache_alloc(page_table_cache);
+    pcb->user_page_table = kmem_cache_alloc(page_table_cache);
+    if (pcb->user_page_table != NULL)
+        clear_user_page_table(pcb->user_page_table);    // free_process walks it for user pages
+    pcb->mmap_page_table = kmem_cache_alloc(page_table_cache);
+    pcb->kernel_stack = kernel_stack ? kernel_stack : (uint32_t)kmem_cache_alloc(kernel_stack_cache);
+    if (pcb->page_directory == NULL || pcb->user_page_table == NULL || pcb->mmap_page_table == NULL || pcb->kernel_stack == 0) {
+        free_process(pcb, kernel_stack == 0);
+        return NULL;
+    }
+    return pcb;
+}
+
+/** 
+ * free_process
+ * 
+ * Description: Frees a pcb, its user pages and what alloc_process allocated for it
+ * Inputs: pcb - process that is no longer on any terminal
+ *         free_stack - 0 to keep the kernel stack for reuse
+ * Outputs: none
+ * Side Effects: Returns memory to the process caches and the frame allocator
+ */
+static void free_process(pcb_t* pcb, int32_t free_stack) {
+    // user pages were faulted in one frame at a time
+    if (pcb->user_page_table != NULL)
+        free_user_pages(pcb->user_page_table);
+    kmem_cache_free(page_table_cache, pcb->page_directory);
+    kmem_cache_free(page_table_cache, pcb->user_page_table);
+    kmem_cache_free(page_table_cache, pcb->mmap_page_table);
+    if (free_stack)
+        kmem_cache_free(kernel_stack_cache, (void*)pcb->kernel_stack);
+    kmem_cache_free(pcb_cache, pcb);
+}
+
+/** 
+ * execute_process
+ * 
+ * Description: execute, optionally on a kernel stack the caller is done with
+ * Inputs: command - command to run
+ *         kernel_stack - kernel stack for the new process, 0 to allocate one
+ * Outputs: return value from executed program
+ */
+static int32_t execute_process(const uint8_t * command, uint32_t kernel_stack) {
     if (command == NULL)
         return -1;
 	pid++; // increment pid because we want to make pcd for the child process
-    // Increment current pid
-    if (pid > MAX_PID) { // don't allow a 7th process, allow pid 0-5
-        pid--;
-        printf("\nMax processes reached. Type exit, idiot, if not then have fun diddling your bits\n");
-        return 0;
-    }
     terminal_process_num[cur_execute_terminal]++;       // increment pid of current terminal
 
     // Set max args to 128
@@ -197,46 +263,40 @@ int32_t execute(const uint8_t * command) {
     }
 
     // Check for executable
-    dentry_t dentry; 
-    if (read_dentry_by_name((uint8_t*)parsed_command, &dentry) != 0) {
+    const dentry_t* dentry; 
+    if (lookup_dentry((uint8_t*)parsed_command, &dentry) != 0) {
         pid--;
         terminal_process_num[cur_execute_terminal]--;
         return -1;
     }
 
-    uint32_t file_size = 0;
-    file_size = get_file_len_by_dentry(dentry);
-    uint8_t buf[4]; // buf to read file into, 4 Bytes to contain the 4 magic numbers to be read
-    read_data(dentry.inodeNum, 0, buf, 4); // read 4 bytes, those contain the magic num
-
-    // compare the magic 4 bytes to expected values from first 4 bytes of executable
-    if (buf[0] != 0x7f || buf[1] != 0x45 || buf[2] != 0x4C || buf[3] != 0x46) {
-		pid--;
+    // validated header and shared page layout come from the exec cache, a respawned shell hits it
+    exec_image_t image;
+    if (get_exec_image(dentry->inodeNum, &image) != 0) {
+        pid--;
         terminal_process_num[cur_execute_terminal]--;
         return -1;
     }
+    uint32_t entry_point_ip = image.entry_point;
 
-    // Get correct eip from executable
-    // bytes 24-27 is 4 bytes
-    uint8_t eip_bytes[4];
-    uint32_t entry_point_ip;
-    read_data(dentry.inodeNum, 24, eip_bytes, 4); // want the 4 bytes in the file at 24-27 for EIP
-    entry_point_ip = *((uint32_t*)eip_bytes);
-
-
-    // Set up paging
-    // Virtual address is 128MB
-    map_virtual_addr_to_physical(USER_MEM_START, USER_PHYS_MEM_START + (cur_execute_terminal * USER_MEM_SIZE) + (terminal_process_num[cur_execute_terminal] * NUM_TERMINALS * USER_MEM_SIZE));
-
-    // flush TLB
-    // flush_tlb();
-
-    // The program image itself is linked to execute at virtual address 0x08048000
-    // This accounts for the program offset we need to execute
-    read_data(dentry.inodeNum, 0, (uint8_t*)0x08048000, file_size);
+    // Create PCB, the number of processes is only limited by memory
+    pcb_t* pcb_start = alloc_process(kernel_stack);
+    if (pcb_start == NULL) {
+        pid--;
+        terminal_process_num[cur_execute_terminal]--;
+        printf("\nOut of memory\n");
+        return -1;
+    }
+    pcb_start->parent = terminal_pcbs[cur_execute_terminal];
+    terminal_pcbs[cur_execute_terminal] = pcb_start;
 
-    // Create PCB
-    pcb_t* pcb_start = getPCB();
+    // Set up paging in a page directory of its own that shares the kernel's global pages
+    // Virtual address is 128MB, backed by a 4kb page table that starts out empty.
+    // Shared text of the program image linked at 0x08048000 is mapped in one copy of the
+    // cached page table entries, private pages are faulted in from the file on first touch
+    init_page_directory(pcb_start->page_directory);
+    map_exec_image(pcb_start->user_page_table, image.inode);
+    map_user_page_table(pcb_start->page_directory, pcb_start->user_page_table);
 
     //set stdin and stdout in the fda at index 0 and 1 respectively
     pcb_start->fda[0].fops = (uint32_t*)terminal_fops;
@@ -252,9 +312,33 @@ int32_t execute(const uint8_t * command) {
     // store args in pcb
     pcb_start->params = parsed_args;
 
+    // page faults in the 128MB page are served from this image
+    pcb_start->image = image;
+
+    // start with an empty mmap window
+    clear_mmap_page_table(pcb_start->mmap_page_table);
+    map_mmap_page_table(pcb_start->page_directory, pcb_start->mmap_page_table);
+    pcb_start->mmap_pages = 0;
+
+    uint32_t flags;
+    // the parent sleeps in execute until the child halts, the child runs in its place.
+    // Handed over with interrupts off, a tick in between would leave the blocked parent off
+    // the run queue or save the parent's context into the child
+    cli_and_save(flags);
+    pcb_start->terminal = cur_execute_terminal;
+    pcb_start->state = TASK_RUNNING;
+    sched_init_task(pcb_start, pcb_start->parent);
+    if (pcb_start->parent != NULL)
+        pcb_start->parent->state = TASK_BLOCKED;
+    set_current_task(pcb_start);
+
+    // switch to the new address space, the kernel's global pages stay in the TLB
+    load_page_directory(pcb_start->page_directory);
+    restore_flags(flags);
+
     //set pid in the pcb
     pcb_start->pid = pid;
-    pcb_start->parent_pid = pid - 1;
+    pcb_start->parent_pid = pcb_start->parent ? pcb_start->parent->pid : -1;
 
 
     // Prepare for Context Switch
@@ -273,7 +357,7 @@ int32_t execute(const uint8_t * command) {
 
     // set SS0 and ESP0 fields of TSS
 	tss.ss0 = KERNEL_DS;
-    tss.esp0 = USER_PHYS_MEM_START - KERNEL_STACK_SIZE*(cur_execute_terminal+1) - (terminal_process_num[cur_execute_terminal]) * NUM_TERMINALS * KERNEL_STACK_SIZE - 4; // 4 to account for ebp
+    tss.esp0 = getKernelStack();
 
     // Push IRET context to kernel stack
     uint32_t ret_val;
@@ -363,8 +447,8 @@ int32_t open(const uint8_t * filename) {
 	if (!filename)											// if invalid filename, return error
 		return -1;
 	
-	dentry_t file;
-	if (read_dentry_by_name(filename, &file))				// check if file exists
+	const dentry_t* file;
+	if (lookup_dentry(filename, &file))				// check if file exists, resolved once for file_open too
 		return -1;
 
 	pcb_t* pcb = getPCB();			// calculate current process pcb
@@ -381,14 +465,14 @@ int32_t open(const uint8_t * filename) {
 		return -1;											// no open spots in fda array, return error
 
 
-	if (file.fileType == 0) {					// 0 - device
+	if (file->fileType == 0) {					// 0 - device
 		if (RTC_open(fda_index, filename))
 			return -1;
-	} else if (file.fileType == 1){
+	} else if (file->fileType == DIR){
         if (dir_open(fda_index, filename))		// 1 - directory
 			return -1;
-    } else if (file.fileType == 2) {
-        if (file_open(fda_index, filename))		// 2 - normal file
+    } else if (IS_REGULAR_FILE(file->fileType)) {
+        if (file_open_by_dentry(fda_index, file))		// 2 - normal file, 3 - compressed file
 			return -1;
     }
 
@@ -455,15 +539,56 @@ int32_t vidmap(uint8_t ** screen_start) {
 
     *screen_start = (uint8_t *) USER_MEM_START + USER_MEM_SIZE;
 
-    // uint32_t vid_mem = VIDEO;
+    // the terminal's vidmap page table already points at the screen or the backing page
+    map_vidmap_page_table(getPCB()->page_directory, cur_execute_terminal);
+    return USER_MEM_START+USER_MEM_SIZE;
+}
+
+/** 
+ * mmap
+ * 
+ * Description: Maps an open file's data blocks read-only into the caller's mmap window,
+ *              so it can be read with no copy through read()
+ * Inputs: fd - open regular file to map
+ *         start - filled with the user address of the first byte of the file
+ * Outputs: Length of the mapped file in bytes on success, -1 on failure
+ * Side Effects: Uses ceil(length / 4kb) pages of the mmap window until the process halts
+ */
+int32_t mmap(int32_t fd, uint8_t ** start) {
+    uint32_t length, num_pages, i, j;
+    int32_t run;
+    uint8_t* block;
+
+    if (fd < FDA_MIN_INDEX || fd > FDA_MAX_INDEX)
+        return -1;
+    if ((uint32_t) start < USER_MEM_START || (uint32_t) start > USER_MEM_START + USER_MEM_SIZE - sizeof(uint8_t *))
+        return -1;
+
+    pcb_t* pcb_ptr = getPCB();				// calculate address of current pcb
+    if (pcb_ptr->fda[fd].flags == 0 || pcb_ptr->fda[fd].fops != (uint32_t *) file_fops)
+        return -1;                          // only regular files are backed by data blocks
 
-    // if (cur_display_terminal != cur_execute_terminal) {
-    //     vid_mem = terminal_vidmem[cur_execute_terminal];
-    // }
+    length = getFileLen(fd);
+    num_pages = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (pcb_ptr->mmap_pages + num_pages > MMAP_MAX_PAGES)
+        return -1;
 
-    // This will currently not show up immediately in video memory
-    map_virtual_addr_to_physical_4kb_page((uint32_t)*screen_start, VIDEO);
-    return USER_MEM_START+USER_MEM_SIZE;
+    // check every extent first so a bad file doesn't leave a partial mapping behind
+    for (i = 0; i < num_pages; i += run) {
+        run = get_file_extent(pcb_ptr->fda[fd].inode, i, &block);
+        if (run <= 0 || ((uint32_t) block & BITMASK_12BIT))
+            return -1;
+    }
+
+    *start = (uint8_t *) MMAP_MEM_START + pcb_ptr->mmap_pages * BLOCK_SIZE;
+    for (i = 0; i < num_pages; i += run) {
+        run = get_file_extent(pcb_ptr->fda[fd].inode, i, &block);
+        for (j = 0; j < run; j++)
+            map_mmap_readonly_4kb_page(pcb_ptr->mmap_page_table, (uint32_t) *start + (i + j) * BLOCK_SIZE, (uint32_t) block + j * BLOCK_SIZE, CACHE_WB);
+    }
+    pcb_ptr->mmap_pages += num_pages;
+
+    return length;
 }
 
 /** 
@@ -488,6 +613,169 @@ int32_t sigreturn (void) {
     return 0;
 }
 
+/** 
+ * getdents
+ * 
+ * Description: Lists an open directory, filling buf with as many dirent_t records as fit
+ *              instead of one file name per read() call
+ * Inputs: fd - open directory
+ *         buf - user buffer for the records
+ *         nbytes - size of buf
+ * Outputs: Number of bytes filled, 0 at end of directory, -1 on failure
+ * Side Effects: Advances the directory position
+ */
+int32_t getdents(int32_t fd, void * buf, int32_t nbytes) {
+	if (!buf)												// error checking for NULL buffer
+		return -1;
+
+	if (fd < 0 || fd > FDA_MAX_INDEX)
+		return -1;
+	pcb_t* pcb_ptr = getPCB();			// calculate address of current pcb
+	if (pcb_ptr->fda[fd].flags == 0 || pcb_ptr->fda[fd].fops != (uint32_t *) directory_fops)
+		return -1;
+
+	return dir_getdents(fd, buf, nbytes);
+}
+
+/** 
+ * stat
+ * 
+ * Description: Gives a file's type, length, inode and block count from its dentry and inode,
+ *              so a program can size a buffer without reading the file to its end
+ * Inputs: filename - name of the file
+ *         buf - user stat_t to fill
+ * Outputs: 0 on success, -1 on failure
+ * Side Effects: None
+ */
+int32_t stat(const uint8_t * filename, struct stat_t * buf) {
+	const dentry_t* file;
+
+	if (!filename || !buf)
+		return -1;
+	if (lookup_dentry(filename, &file))				// check if file exists
+		return -1;
+
+	return stat_by_inode(file->fileType, file->inodeNum, buf);
+}
+
+/** 
+ * fstat
+ * 
+ * Description: Gives the type, length, inode and block count of an open file
+ * Inputs: fd - open file, directory or rtc
+ *         buf - user stat_t to fill
+ * Outputs: 0 on success, -1 on failure or for the terminal
+ * Side Effects: None
+ */
+int32_t fstat(int32_t fd, struct stat_t * buf) {
+	if (!buf)
+		return -1;
+
+	if (fd < 0 || fd > FDA_MAX_INDEX)
+		return -1;
+	pcb_t* pcb_ptr = getPCB();			// calculate address of current pcb
+	if (pcb_ptr->fda[fd].flags == 0)
+		return -1;
+
+	// the fops table tells what kind of file the fd was opened as
+	if (pcb_ptr->fda[fd].fops == (uint32_t *) file_fops)
+		return stat_by_inode(FILE, pcb_ptr->fda[fd].inode, buf);
+	if (pcb_ptr->fda[fd].fops == (uint32_t *) directory_fops)
+		return stat_by_inode(DIR, 0, buf);
+	if (pcb_ptr->fda[fd].fops == (uint32_t *) RTC_fops)
+		return stat_by_inode(RTC, 0, buf);
+	return -1;
+}
+
+/** 
+ * lseek
+ * 
+ * Description: Moves the position of an open regular file, so a region can be re-read
+ *              without closing and reading up to it again
+ * Inputs: fd - open regular file
+ *         offset - bytes to move by, relative to whence
+ *         whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Outputs: New position on success, -1 on failure
+ * Side Effects: Sets the fd's file position
+ */
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence) {
+	if (fd < FDA_MIN_INDEX || fd > FDA_MAX_INDEX)
+		return -1;
+	pcb_t* pcb_ptr = getPCB();			// calculate address of current pcb
+	if (pcb_ptr->fda[fd].flags == 0 || pcb_ptr->fda[fd].fops != (uint32_t *) file_fops)
+		return -1;							// only regular files have a position to move
+
+	return file_lseek(fd, offset, whence);
+}
+
+/** 
+ * pread
+ * 
+ * Description: Reads an open regular file at an explicit offset
+ * Inputs: fd - open regular file
+ *         buf - user buffer to read into
+ *         nbytes - number of bytes to read
+ *         offset - offset in file to begin reading from
+ * Outputs: Number of bytes read on success, -1 on failure
+ * Side Effects: None, the fd's file position is unchanged
+ */
+int32_t pread(int32_t fd, void * buf, int32_t nbytes, int32_t offset) {
+	if (!buf)												// error checking for NULL buffer
+		return -1;
+
+	if (fd < FDA_MIN_INDEX || fd > FDA_MAX_INDEX)
+		return -1;
+	pcb_t* pcb_ptr = getPCB();			// calculate address of current pcb
+	if (pcb_ptr->fda[fd].flags == 0 || pcb_ptr->fda[fd].fops != (uint32_t *) file_fops)
+		return -1;
+
+	return file_pread(fd, buf, nbytes, offset);
+}
+
+/** 
+ * nice
+ * 
+ * Description: Changes the calling process's nice value, the highest MLFQ level it can reach.
+ *              0 is the default, MLFQ_LEVELS - 1 keeps it with the CPU bound batch work
+ * Inputs: increment - added to the nice value, negative to raise priority back
+ * Outputs: The new nice value, clamped between 0 and MLFQ_LEVELS - 1
+ * Side Effects: Children executed afterwards start with the same nice value
+ */
+int32_t nice(int32_t increment) {
+    uint32_t flags;
+    int32_t ret;
+
+    cli_and_save(flags);
+    ret = set_task_nice(getPCB(), increment);
+    restore_flags(flags);
+    return ret;
+}
+
+/** 
+ * sched_periodic
+ * 
+ * Description: Moves the calling process into the periodic real-time class. Each period it
+ *              gets its budget of CPU ahead of all best-effort work, earliest deadline first,
+ *              for programs that draw a frame per RTC tick like fish
+ * Inputs: period_ms - time between releases, 0 to go back to best-effort
+ *         budget_ms - CPU time reserved each period
+ * Outputs: 0 on success, -1 for bad arguments or if the reservation doesn't fit in RT_MAX_UTIL
+ * Side Effects: Past its budget the process runs best-effort until the next period.
+ *               Children don't inherit the reservation, it ends when the process halts
+ */
+int32_t sched_periodic(int32_t period_ms, int32_t budget_ms) {
+    uint32_t flags;
+    int32_t ret;
+
+    if (period_ms < 0 || budget_ms < 0 || period_ms > RT_MAX_PERIOD / 1000 || budget_ms > period_ms)
+        return -1;
+
+    cli_and_save(flags);
+    ret = set_task_periodic(getPCB(), period_ms * 1000, budget_ms * 1000);
+    restore_flags(flags);
+    return ret;
+}
+
 /** 
  * flush_tlb
  * 
@@ -513,7 +801,8 @@ void flush_tlb() {
  * Description: switch currently displayed terminal
  * Inputs: none
  * Outputs: none
- * Side Effects: copy old vid mem to unique location, set physical VIDEO mem to new terminals
+ * Side Effects: copy old vid mem to unique location, set physical VIDEO mem to new terminals,
+ *               makes it the display terminal and wakes its readers
  */
 void change_display_terminal(int32_t new_terminal) {
 	terminal_t* old_terminal = ((terminal_t *)terminal_data[cur_display_terminal]);
@@ -530,6 +819,15 @@ void change_display_terminal(int32_t new_terminal) {
 
 	// copy new terminal memory into video memory
 	memcpy((uint32_t*) VIDEO, (uint32_t*) terminal_vidmem[new_terminal], KERNEL_STACK_SIZE/2);
+
+    // vidmap of the old terminal's processes now writes to its backing page, the new one's to the screen
+    set_vidmap_page(cur_display_terminal, terminal_vidmem[cur_display_terminal], video_cache_type(terminal_vidmem[cur_display_terminal]));
+    set_vidmap_page(new_terminal, VIDEO, CACHE_WC);
+
+    // the new terminal is displayed from here on, so a reader that saw enter while it
+    // was hidden can finish now
+    cur_display_terminal = new_terminal;
+    terminal_wake_readers(new_terminal);
     sti();
 	// printf("old terminal: %d, new terminal: %d", old_terminal, new_terminal);
 }
@@ -581,10 +879,34 @@ void setDisplayTerm(int set) {
 /** 
  * getPCB
  * 
- * Description: getPCB using cur execute term
+ * Description: pcb of the running task, which runs on the cur execute term
  * Inputs: none
  * Outputs: PCB
  */
 pcb_t * getPCB() {
-    return (pcb_t*)(USER_PHYS_MEM_START - KERNEL_STACK_SIZE*(getExecuteTerm()+1) - (terminal_process_num[getExecuteTerm()]) * NUM_TERMINALS * KERNEL_STACK_SIZE);
+    return get_current_task();
+}
+
+/** 
+ * getKernelStack
+ * 
+ * Description: top of the kernel stack of the cur execute process
+ * Inputs: none
+ * Outputs: value for tss.esp0
+ */
+uint32_t getKernelStack() {
+    return getPCB()->kernel_stack + KERNEL_STACK_SIZE - 4; // 4 to account for ebp
+}
+
+/** 
+ * init_processes
+ * 
+ * Description: Creates the slab caches processes are allocated from, after kmalloc_init
+ * Inputs: none
+ * Outputs: none
+ */
+void init_processes() {
+    pcb_cache = kmem_cache_create((int8_t*)"pcb", sizeof(pcb_t), 0);
+    kernel_stack_cache = kmem_cache_create((int8_t*)"kernel_stack", KERNEL_STACK_SIZE, KERNEL_STACK_SIZE);
+    page_table_cache = kmem_cache_create((int8_t*)"page_table", KB_SIZE * sizeof(int32_t), FRAME_SIZE);
 }
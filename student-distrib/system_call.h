@@ -9,16 +9,19 @@
 #include "rtc.h"
 #include "Terminal.h"
 #include "keyboard.h"
+#include "loader.h"
+#include "frame.h"
+#include "kmalloc.h"
 
 #define MAX_CMD_CHARS       128
 #define USER_MEM_START              0x8000000
-#define USER_PHYS_MEM_START                0x800000
 #define USER_MEM_SIZE                0x400000
+#define MMAP_MEM_START              0x8800000   // 136 MB, 4MB window of read-only 4kb file pages
+#define MMAP_MAX_PAGES              1024        // 4kb pages in the mmap window
 #define KERNEL_STACK_SIZE                0x2000
 #define FDA_MIN_INDEX       2
 #define FDA_MAX_INDEX       7
 #define FDA_MAX_OF          8
-#define MAX_PID             5
 #define EXCEP_NUM           256
 #define SYSCALL_FOPS_LEN    4
 #define SPACE               0x20
@@ -49,6 +52,13 @@ typedef struct fda_entry_t {
     uint32_t flags;
 } fda_entry_t;
 
+// task states, a task is on the run queue only while TASK_RUNNABLE
+#define TASK_RUNNING        0
+#define TASK_RUNNABLE       1
+#define TASK_BLOCKED        2       // waiting in execute for its child to halt
+#define TASK_SLEEPING       3       // on a wait queue
+#define TASK_IDLE           4       // the idle task, never on the run queue
+
 typedef struct pcb_t {
     fda_entry_t fda[FDA_MAX_OF];
 
@@ -60,6 +70,36 @@ typedef struct pcb_t {
 
     int8_t* params;
     uint32_t status_flags;
+
+    uint32_t mmap_pages;    // 4kb pages used so far in the mmap window
+
+    exec_image_t image;     // executable the 128MB page is demand paged from
+
+    uint32_t user_pages;    // private 4kb frames mapped in the 128MB page
+    int32_t* page_directory;    // address space, loaded in CR3 while the process runs
+    int32_t* user_page_table;   // 4kb pages of the 128MB page
+    int32_t* mmap_page_table;   // 4kb pages of the mmap window
+    uint32_t kernel_stack;      // bottom of the process's KERNEL_STACK_SIZE kernel stack
+    struct pcb_t* parent;       // process below it on its terminal, NULL for the terminal's first shell
+
+    // task state for the scheduler
+    int32_t terminal;           // terminal the process runs on
+    int32_t state;              // TASK_*
+    uint32_t esp;               // kernel context saved by the scheduler
+    uint32_t ebp;
+    struct pcb_t* run_prev;     // run queue or wait queue links
+    struct pcb_t* run_next;
+    int32_t run_level;          // run queue level the task is on
+    int32_t level;              // MLFQ level, 0 is the highest priority
+    int32_t nice;               // best level the task can reach, set with the nice syscall
+    uint32_t quantum_left;      // microseconds left in its quantum
+
+    // periodic real-time class, rt_period is 0 for best-effort tasks
+    uint32_t rt_period;         // microseconds between releases
+    uint32_t rt_budget;         // microseconds of CPU guaranteed each period
+    uint32_t rt_budget_left;    // budget left this period, run as best-effort at 0
+    uint32_t rt_deadline;       // end of the current period, EDF orders by it
+    struct pcb_t* rt_next;      // list of every real-time task
     
     // add field for grep and rtc frequency
 } pcb_t;
@@ -88,8 +128,36 @@ int32_t getargs(uint8_t * buf, int32_t nbytes);
 // vidmap syscall, used in fish
 int32_t vidmap(uint8_t ** screen_start);
 int32_t set_handler(int32_t signum, void * handler_address);
+
+// mmap syscall, maps an open file's data blocks read-only into the caller's mmap window
+int32_t mmap(int32_t fd, uint8_t ** start);
+
 int32_t sigreturn (void);
 
+// defined in filesys.h, which can include this header before getting to it
+struct stat_t;
+
+// stat syscall, type and size of a file by name
+int32_t stat(const uint8_t * filename, struct stat_t * buf);
+
+// fstat syscall, type and size of an open file
+int32_t fstat(int32_t fd, struct stat_t * buf);
+
+// lseek syscall, moves the position of an open file
+int32_t lseek(int32_t fd, int32_t offset, int32_t whence);
+
+// pread syscall, reads an open file at an offset without moving its position
+int32_t pread(int32_t fd, void * buf, int32_t nbytes, int32_t offset);
+
+// lower the calling process's priority, returns its new nice value
+int32_t nice(int32_t increment);
+
+// join the periodic real-time class, 0 on success
+int32_t sched_periodic(int32_t period_ms, int32_t budget_ms);
+
+// getdents syscall, lists a directory with one dirent_t record per entry
+int32_t getdents(int32_t fd, void * buf, int32_t nbytes);
+
 //clear cr3 using inline
 void flush_tlb();
 
@@ -127,4 +195,10 @@ void setDisplayTerm(int set);
 // cur execute term PCB getter
 pcb_t * getPCB();
 
+// top of the kernel stack of the cur execute process, for tss.esp0
+uint32_t getKernelStack();
+
+// creates the slab caches processes are allocated from
+void init_processes();
+
 #endif 
@@ -5,6 +5,10 @@
 #include "rtc.h"
 #include "Terminal.h"
 #include "filesys.h"
+#include "loader.h"
+#include "system_call.h"
+#include "bcache.h"
+#include "scheduler.h"
 
 #define PASS 1
 #define FAIL 0
@@ -529,6 +533,677 @@ int terminal_test() {
 // 	}
 // 	return PASS;
 // }
+
+/** 
+ * dentry_lookup_test
+ * 
+ * Asserts that every named dentry is found through the hash index with the
+ * same inode read_dentry_by_index gives, and that a missing name is not found
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: File system dentry hash index
+ * Files: filesys.h/c
+ */
+int dentry_lookup_test() {
+	TEST_HEADER;
+
+	int i;
+	dentry_t by_index;
+	const dentry_t* by_name;
+	uint8_t name[MAX_FILE_NAME_LEN + 1];
+
+	for (i = 0; i < MAX_DENTRIES; i++) {
+		if (read_dentry_by_index(i, &by_index) || by_index.fileName[0] == NULL)
+			continue;
+		memcpy(name, by_index.fileName, MAX_FILE_NAME_LEN);
+		name[MAX_FILE_NAME_LEN] = NULL;
+		if (lookup_dentry(name, &by_name) || by_name->inodeNum != by_index.inodeNum)
+			return FAIL;
+	}
+	if (lookup_dentry((uint8_t*)"doesnotexist", &by_name) == 0)
+		return FAIL;
+	return PASS;
+}
+
+/** 
+ * extent_read_test
+ * 
+ * Asserts that the extents of a multi block file cover each of its blocks once
+ * and that one large read matches the same file read in unaligned pieces
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: File system extent maps
+ * Files: filesys.h/c
+ */
+static uint8_t extent_whole[10 * BLOCK_SIZE];
+static uint8_t extent_pieces[10 * BLOCK_SIZE];
+int extent_read_test() {
+	TEST_HEADER;
+
+	const dentry_t* dentry;
+	uint8_t* addr;
+	int32_t len, run, got, i, num_blocks;
+
+	if (lookup_dentry((uint8_t*)"fish", &dentry))
+		return FAIL;
+	len = get_file_len_by_inode(dentry->inodeNum);
+	if (len <= 0 || len > sizeof(extent_whole))
+		return FAIL;
+
+	num_blocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	for (i = 0; i < num_blocks; i += run) {
+		run = get_file_extent(dentry->inodeNum, i, &addr);
+		if (run <= 0 || i + run > num_blocks || addr != get_data_block_addr(dentry->inodeNum, i))
+			return FAIL;
+	}
+	if (get_file_extent(dentry->inodeNum, num_blocks, &addr) != 0)
+		return FAIL;
+
+	if (read_data(dentry->inodeNum, 0, extent_whole, sizeof(extent_whole)) != len)
+		return FAIL;
+	for (i = 0; i < len; i += got) {
+		got = read_data(dentry->inodeNum, i, extent_pieces + i, 1000);
+		if (got <= 0)
+			return FAIL;
+	}
+	for (i = 0; i < len; i++) {
+		if (extent_whole[i] != extent_pieces[i])
+			return FAIL;
+	}
+	return PASS;
+}
+
+/** 
+ * overlay_write_test
+ * 
+ * Asserts that a created file is listed after the boot block's dentries,
+ * reads back what was written across a block boundary, and can't be created twice
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Creates "overlaytest" in the overlay
+ * Coverage: Writable overlay
+ * Files: filesys.h/c
+ */
+int overlay_write_test() {
+	TEST_HEADER;
+
+	const dentry_t* dentry;
+	dentry_t listed;
+	uint8_t data[100], back[100];
+	int i;
+
+	for (i = 0; i < 100; i++)
+		data[i] = i;
+	if (create_file((uint8_t*)"overlaytest", 11) || create_file((uint8_t*)"overlaytest", 11) == 0)
+		return FAIL;
+	if (lookup_dentry((uint8_t*)"overlaytest", &dentry) || get_file_len_by_inode(dentry->inodeNum) != 0)
+		return FAIL;
+
+	for (i = 0; read_dentry_by_index(i, &listed) == 0; i++);
+	if (read_dentry_by_index(i - 1, &listed) || listed.inodeNum != dentry->inodeNum)
+		return FAIL;
+
+	if (write_data(dentry->inodeNum, BLOCK_SIZE - 50, data, 100) != 100)
+		return FAIL;
+	if (get_file_len_by_inode(dentry->inodeNum) != BLOCK_SIZE + 50)
+		return FAIL;
+	if (read_data(dentry->inodeNum, BLOCK_SIZE - 50, back, 100) != 100)
+		return FAIL;
+	for (i = 0; i < 100; i++) {
+		if (back[i] != data[i])
+			return FAIL;
+	}
+	return PASS;
+}
+
+/** 
+ * getdents_test
+ * 
+ * Asserts that listing the directory a few records at a time gives every
+ * dentry in index order, with file sizes, and then 0 at the end
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Uses fd 2 of the current pcb
+ * Coverage: Batched directory listing
+ * Files: filesys.h/c
+ */
+int getdents_test() {
+	TEST_HEADER;
+
+	dirent_t records[4];
+	dentry_t dentry;
+	int32_t cnt, i, index;
+
+	if (dir_open(2, (uint8_t*)"."))
+		return FAIL;
+	index = 0;
+	while ((cnt = dir_getdents(2, records, sizeof(records))) > 0) {
+		if (cnt % sizeof(dirent_t))
+			return FAIL;
+		for (i = 0; i < cnt / sizeof(dirent_t); i++, index++) {
+			if (read_dentry_by_index(index, &dentry) || records[i].inodeNum != dentry.inodeNum ||
+				strncmp(records[i].fileName, dentry.fileName, MAX_FILE_NAME_LEN))
+				return FAIL;
+			if (dentry.fileType == FILE && records[i].fileSize != get_file_len_by_inode(dentry.inodeNum))
+				return FAIL;
+		}
+	}
+	if (cnt != 0 || read_dentry_by_index(index, &dentry) == 0)
+		return FAIL;
+	if (dir_getdents(2, records, sizeof(dirent_t) - 1) != -1)
+		return FAIL;
+	dir_close(2);
+	return PASS;
+}
+
+/** 
+ * stat_test
+ * 
+ * Asserts that stat reports a file's length and block count from its inode,
+ * reports the directory with no size, and fails for a missing name
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: stat syscall
+ * Files: system_call.h/c, filesys.h/c
+ */
+int stat_test() {
+	TEST_HEADER;
+
+	stat_t st;
+	const dentry_t* dentry;
+
+	if (lookup_dentry((uint8_t*)"verylargetextwithverylongname.tx", &dentry))
+		return FAIL;
+	if (stat((uint8_t*)"verylargetextwithverylongname.tx", &st) || st.fileType != FILE || st.inodeNum != dentry->inodeNum)
+		return FAIL;
+	if (st.fileSize != get_file_len_by_inode(dentry->inodeNum) || st.numBlocks != (st.fileSize + BLOCK_SIZE - 1) / BLOCK_SIZE)
+		return FAIL;
+	if (stat((uint8_t*)".", &st) || st.fileType != DIR || st.fileSize != 0)
+		return FAIL;
+	if (stat((uint8_t*)"doesnotexist", &st) == 0)
+		return FAIL;
+	return PASS;
+}
+
+/** 
+ * lseek_pread_test
+ * 
+ * Asserts that a read after lseek and a pread at an offset get the same bytes
+ * as read_data, that pread leaves the position alone, and that seeking before
+ * the start of the file fails
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Uses fd 2 of the current pcb
+ * Coverage: Positional file reads
+ * Files: filesys.h/c
+ */
+int lseek_pread_test() {
+	TEST_HEADER;
+
+	const dentry_t* dentry;
+	uint8_t got[16], want[16];
+	int32_t len, i;
+
+	if (lookup_dentry((uint8_t*)"verylargetextwithverylongname.tx", &dentry) || file_open_by_dentry(2, dentry))
+		return FAIL;
+	len = get_file_len_by_inode(dentry->inodeNum);
+
+	if (file_lseek(2, 4090, SEEK_SET) != 4090 || file_read(2, got, 16) != 16)
+		return FAIL;
+	read_data(dentry->inodeNum, 4090, want, 16);
+	for (i = 0; i < 16; i++) {
+		if (got[i] != want[i])
+			return FAIL;
+	}
+
+	if (file_pread(2, got, 16, 100) != 16)
+		return FAIL;
+	read_data(dentry->inodeNum, 100, want, 16);
+	for (i = 0; i < 16; i++) {
+		if (got[i] != want[i])
+			return FAIL;
+	}
+
+	if (file_lseek(2, 0, SEEK_CUR) != 4106 || file_lseek(2, -10, SEEK_END) != len - 10)
+		return FAIL;
+	if (file_lseek(2, -len - 1, SEEK_END) != -1 || file_lseek(2, 0, 3) != -1)
+		return FAIL;
+	file_close(2);
+	return PASS;
+}
+
+/** 
+ * exec_cache_test
+ * 
+ * Asserts that the second lookup of an executable is a cache hit returning the
+ * same image, and that a text file is rejected without being cached
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Fills an exec cache entry
+ * Coverage: Exec image cache
+ * Files: loader.h/c
+ */
+int exec_cache_test() {
+	TEST_HEADER;
+
+	const dentry_t* dentry;
+	exec_image_t first, second;
+	exec_cache_stats_t before, after;
+
+	if (lookup_dentry((uint8_t*)"ls", &dentry))
+		return FAIL;
+	if (get_exec_image(dentry->inodeNum, &first))
+		return FAIL;
+	get_exec_cache_stats(&before);
+	if (get_exec_image(dentry->inodeNum, &second))
+		return FAIL;
+	get_exec_cache_stats(&after);
+	if (after.hits != before.hits + 1 || after.misses != before.misses)
+		return FAIL;
+	if (first.entry_point != second.entry_point || first.length != second.length)
+		return FAIL;
+
+	if (lookup_dentry((uint8_t*)"frame0.txt", &dentry) || get_exec_image(dentry->inodeNum, &first) == 0)
+		return FAIL;
+	return PASS;
+}
+/* Buffer cache test
+ * 
+ * Asserts that a second read of a disk block hits the cache and returns the same bytes,
+ * and that reads past the block or the disk are rejected
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Caches the boot block when the filesystem is on disk
+ * Coverage: Buffer cache
+ * Files: bcache.h/c
+ */
+int bcache_test() {
+	TEST_HEADER;
+
+	uint8_t first[64], second[64];
+	bcache_stats_t before, after;
+	int i;
+
+	if (bcache_read(0, ATA_BLOCK_SIZE - 8, first, 16) != -1 || bcache_read(0xFFFFFFFF, 0, first, 16) != -1)
+		return FAIL;
+	// the filesystem came from a module, there is no disk to read
+	if (bcache_read(0, 0, first, sizeof(first)) < 0)
+		return PASS;
+
+	bcache_get_stats(&before);
+	if (bcache_read(0, 0, second, sizeof(second)) != sizeof(second))
+		return FAIL;
+	bcache_get_stats(&after);
+	if (after.hits != before.hits + 1 || after.misses != before.misses)
+		return FAIL;
+	for (i = 0; i < sizeof(first); i++) {
+		if (first[i] != second[i])
+			return FAIL;
+	}
+	return PASS;
+}
+/* Frame allocator test
+ * 
+ * Asserts that 4KB and kernel frames come back aligned, in the right part of
+ * memory and distinct, and that freeing them restores the free count
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, every frame is freed
+ * Coverage: Frame allocator
+ * Files: frame.h/c
+ */
+int frame_test() {
+	TEST_HEADER;
+
+	frame_stats_t before, during, after;
+	uint32_t small1, small2, kernel;
+	int result = PASS;
+
+	get_frame_stats(&before);
+	small1 = alloc_frame();
+	small2 = alloc_frame();
+	kernel = alloc_kernel_frames(2);
+	get_frame_stats(&during);
+
+	if (small1 == 0 || small2 == 0 || small1 == small2 || (small1 & (FRAME_SIZE - 1)))
+		result = FAIL;
+	if (small1 >= KERNEL_MEM_START && small1 < KERNEL_MEM_END)
+		result = FAIL;
+	if (kernel < KERNEL_MEM_START || kernel >= KERNEL_MEM_END || (kernel & (2 * FRAME_SIZE - 1)))
+		result = FAIL;
+	if (during.free != before.free - 4)
+		result = FAIL;
+
+	free_frames(small1, 1);
+	free_frames(small2, 1);
+	free_frames(kernel, 2);
+	get_frame_stats(&after);
+	if (after.free != before.free)
+		result = FAIL;
+	return result;
+}
+/* Kernel heap test
+ * 
+ * Asserts that a created cache hands out distinct aligned objects and counts them, and
+ * that small and large kmallocs come back usable and are freed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Leaves a "test" cache behind, caches can't be destroyed
+ * Coverage: Slab caches, kmalloc
+ * Files: kmalloc.h/c
+ */
+int kmalloc_test() {
+	TEST_HEADER;
+
+	static kmem_cache_t* cache;
+	kmem_cache_stats_t stats;
+	frame_stats_t before, after;
+	uint8_t *obj1, *obj2, *small, *large;
+	int result = PASS;
+
+	if (cache == NULL)
+		cache = kmem_cache_create((int8_t*)"test", 100, 64);
+	if (cache == NULL)
+		return FAIL;
+
+	obj1 = kmem_cache_alloc(cache);
+	obj2 = kmem_cache_alloc(cache);
+	if (obj1 == NULL || obj2 == NULL || obj1 == obj2)
+		result = FAIL;
+	if (((uint32_t)obj1 & 63) || ((uint32_t)obj2 & 63))
+		result = FAIL;
+	if (cache->stats.active != 2 || cache->stats.total < cache->per_slab)
+		result = FAIL;
+	kmem_cache_free(cache, obj1);
+	kmem_cache_free(cache, obj2);
+	if (cache->stats.active != 0 || cache->stats.frees < 2)
+		result = FAIL;
+
+	get_frame_stats(&before);
+	small = kmalloc(40);
+	large = kmalloc(3 * FRAME_SIZE);
+	if (small == NULL || large == NULL || ((uint32_t)large & (FRAME_SIZE - 1)))
+		result = FAIL;
+	if (small != NULL && large != NULL) {
+		memset(small, 0xAB, 40);
+		memset(large, 0xCD, 3 * FRAME_SIZE);
+		if (small[39] != 0xAB || large[3 * FRAME_SIZE - 1] != 0xCD)
+			result = FAIL;
+	}
+	kfree(small);
+	kfree(large);
+	get_frame_stats(&after);
+	// the 64 byte class may keep a new empty slab, the large run must be gone
+	if (after.free + 1 < before.free)
+		result = FAIL;
+
+	if (get_kmem_cache_stats(0, &stats) != 0 || get_kmem_cache_stats(KMEM_MAX_CACHES, &stats) != -1)
+		result = FAIL;
+	return result;
+}
+/* Page directory test
+ * 
+ * Asserts that global pages are enabled and that a new process directory shares the
+ * kernel's entries and maps nothing of its own
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the directory is freed
+ * Coverage: Per process page directories, CR4 set up
+ * Files: paging.h/c, set_paging_registers.S
+ */
+int page_directory_test() {
+	TEST_HEADER;
+
+	int32_t* directory;
+	uint32_t cr4, i;
+	int result = PASS;
+
+	asm volatile ("movl %%cr4, %0" : "=r"(cr4));
+	if ((cr4 & 0x90) != 0x90)			// PSE and PGE
+		result = FAIL;
+
+	directory = kmalloc(KB_SIZE * sizeof(int32_t));
+	if (directory == NULL)
+		return FAIL;
+	memset(directory, 0xFF, KB_SIZE * sizeof(int32_t));
+	init_page_directory(directory);
+	for (i = 0; i < KB_SIZE; i++) {
+		if (i < (USER_MEM_START >> 22) && directory[i] != page_directory[i])
+			result = FAIL;
+		if (i >= (USER_MEM_START >> 22) && directory[i] != 0)
+			result = FAIL;
+	}
+	if (!(directory[1] & G))
+		result = FAIL;
+	kfree(directory);
+	return result;
+}
+/* Memory type test
+ * 
+ * Asserts that PAT entry 1 is write-combining and that the kernel's page is cached
+ * write-back while text mode memory is write-combining
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: PAT programming, memory types of the kernel mappings
+ * Files: paging.h/c
+ */
+int memory_type_test() {
+	TEST_HEADER;
+
+	uint32_t pat_low, pat_high;
+	int result = PASS;
+
+	asm volatile ("rdmsr" : "=a"(pat_low), "=d"(pat_high) : "c"(IA32_PAT));
+	if (((pat_low >> 8) & 0xFF) != PAT_WC || (pat_low & 0xFF) != PAT_WB)
+		result = FAIL;
+	if (page_directory[1] & (PCD | PWT))
+		result = FAIL;
+	if ((video_page_table[VIDEO >> 12] & (PCD | PWT)) != CACHE_WC)
+		result = FAIL;
+	if (video_cache_type(VIDEO) != CACHE_WC || video_cache_type(KERNEL_MEM_START) != CACHE_WB)
+		result = FAIL;
+	return result;
+}
+/* User page test
+ * 
+ * Asserts that free_user_pages gives back the private frames of a user page table and
+ * leaves shared pages to their owner
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, every frame is freed
+ * Coverage: 4kb user pages
+ * Files: paging.h/c
+ */
+int user_pages_test() {
+	TEST_HEADER;
+
+	frame_stats_t before, after;
+	int32_t* table;
+	uint32_t shared;
+	int result = PASS;
+
+	table = kmalloc(KB_SIZE * sizeof(int32_t));
+	shared = alloc_frame();
+	if (table == NULL || shared == 0)
+		return FAIL;
+	clear_user_page_table(table);
+
+	get_frame_stats(&before);
+	map_user_4kb_page(table, USER_IMAGE_START, alloc_frame(), 1, CACHE_WB);
+	map_user_4kb_page(table, USER_MEM_START + USER_MEM_SIZE - FRAME_SIZE, alloc_frame(), 1, CACHE_WB);
+	map_user_4kb_page(table, USER_IMAGE_START + FRAME_SIZE, shared, 0, CACHE_WB);
+	if (free_user_pages(table) != 2)
+		result = FAIL;
+	get_frame_stats(&after);
+	if (after.free != before.free || table[(USER_IMAGE_START >> 12) & BITMASK_10BIT] != 0)
+		result = FAIL;
+
+	free_frames(shared, 1);
+	kfree(table);
+	return result;
+}
+/* Run queue test
+ * 
+ * Asserts that tasks come off the run queue in the order they were added, and that a
+ * task removed from the middle is skipped
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the queue is emptied of the test tasks
+ * Coverage: Scheduler run queue
+ * Files: scheduler.h/c
+ */
+int run_queue_test() {
+	TEST_HEADER;
+
+	static pcb_t tasks[3];
+	uint32_t flags;
+	int result = PASS;
+
+	cli_and_save(flags);
+	run_queue_add(&tasks[0]);
+	run_queue_add(&tasks[1]);
+	run_queue_add(&tasks[2]);
+	if (tasks[1].state != TASK_RUNNABLE)
+		result = FAIL;
+	run_queue_remove(&tasks[1]);
+	if (run_queue_pop() != &tasks[0] || run_queue_pop() != &tasks[2])
+		result = FAIL;
+	if (run_queue_pop() != NULL)
+		result = FAIL;
+	restore_flags(flags);
+	return result;
+}
+/* Wait queue test
+ * 
+ * Asserts that wake_up empties a wait queue onto the run queue in the order the tasks
+ * went to sleep
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the run queue is emptied of the test tasks
+ * Coverage: Wait queues
+ * Files: scheduler.h/c
+ */
+int wait_queue_test() {
+	TEST_HEADER;
+
+	static pcb_t tasks[2];
+	wait_queue_t queue;
+	uint32_t flags;
+	int result = PASS;
+
+	// two tasks as sleep_on leaves them
+	tasks[0].state = TASK_SLEEPING;
+	tasks[0].run_prev = NULL;
+	tasks[0].run_next = &tasks[1];
+	tasks[1].state = TASK_SLEEPING;
+	tasks[1].run_prev = &tasks[0];
+	tasks[1].run_next = NULL;
+	queue.head = &tasks[0];
+	queue.tail = &tasks[1];
+
+	cli_and_save(flags);
+	wake_up(&queue);
+	if (queue.head != NULL || queue.tail != NULL)
+		result = FAIL;
+	if (tasks[0].state != TASK_RUNNABLE || tasks[1].state != TASK_RUNNABLE)
+		result = FAIL;
+	if (run_queue_pop() != &tasks[0] || run_queue_pop() != &tasks[1])
+		result = FAIL;
+	restore_flags(flags);
+	return result;
+}
+/* MLFQ test
+ * 
+ * Asserts that higher levels run first, that the displayed terminal's tasks are lifted a
+ * level, and that nice values are clamped and carried to children
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the run queue is emptied of the test tasks
+ * Coverage: MLFQ levels, nice
+ * Files: scheduler.h/c
+ */
+int mlfq_test() {
+	TEST_HEADER;
+
+	static pcb_t batch, shell, foreground, child;
+	uint32_t flags;
+	int result = PASS;
+
+	batch.level = MLFQ_LEVELS - 1;
+	batch.terminal = (getDisplayTerm() + 1) % NUM_TERMINALS;
+	shell.level = 0;
+	shell.terminal = batch.terminal;
+	foreground.level = 1;
+	foreground.terminal = getDisplayTerm();
+
+	cli_and_save(flags);
+	run_queue_add(&batch);
+	run_queue_add(&foreground);
+	run_queue_add(&shell);
+	if (foreground.run_level != 0)
+		result = FAIL;
+	if (run_queue_pop() != &foreground || run_queue_pop() != &shell || run_queue_pop() != &batch)
+		result = FAIL;
+	restore_flags(flags);
+
+	if (set_task_nice(&batch, 100) != MLFQ_LEVELS - 1 || set_task_nice(&batch, -100) != 0)
+		result = FAIL;
+	set_task_nice(&shell, 1);
+	sched_init_task(&child, &shell);
+	if (child.nice != 1 || child.level != 1 || child.quantum_left != MLFQ_QUANTUM_US(1))
+		result = FAIL;
+	return result;
+}
+/* EDF test
+ * 
+ * Asserts that real-time reservations past RT_MAX_UTIL or with a bad budget are refused, that
+ * real-time tasks run earliest deadline first ahead of best-effort ones, and that halting
+ * gives a reservation back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the run queue is emptied of the test tasks
+ * Coverage: periodic real-time class, admission control
+ * Files: scheduler.h/c
+ */
+int edf_test() {
+	TEST_HEADER;
+
+	static pcb_t video, audio, batch;
+	uint32_t flags;
+	int result = PASS;
+
+	sched_init_task(&video, NULL);
+	sched_init_task(&audio, NULL);
+	sched_init_task(&batch, NULL);
+	batch.terminal = getDisplayTerm();
+
+	cli_and_save(flags);
+	if (set_task_periodic(&video, 4000, 5000) != -1 || set_task_periodic(&video, 4000, 0) != -1)
+		result = FAIL;
+	if (set_task_periodic(&audio, 20000, 10000) != 0 || set_task_periodic(&video, 10000, 5000) != -1)
+		result = FAIL;
+	if (set_task_periodic(&video, 10000, 2000) != 0)
+		result = FAIL;
+
+	// video's deadline comes first, batch waits for both even on the displayed terminal
+	run_queue_add(&batch);
+	run_queue_add(&audio);
+	run_queue_add(&video);
+	if (run_queue_pop() != &video || run_queue_pop() != &audio || run_queue_pop() != &batch)
+		result = FAIL;
+
+	sched_exit_task(&audio);
+	sched_exit_task(&video);
+	if (audio.rt_period != 0 || set_task_periodic(&batch, 10000, 9000) != 0)
+		result = FAIL;
+	sched_exit_task(&batch);
+	restore_flags(flags);
+	return result;
+}
 /* End filesystem tests */
 
 
@@ -567,6 +1242,23 @@ void launch_tests(){
 	// TEST_OUTPUT("read file", file_read_executable_test());
 	// TEST_OUTPUT("read directory", dir_read_test());
 	// TEST_OUTPUT("read file multiple times", multiple_file_reads_test());
+	TEST_OUTPUT("dentry lookup", dentry_lookup_test());
+	TEST_OUTPUT("extent read", extent_read_test());
+	TEST_OUTPUT("getdents", getdents_test());
+	TEST_OUTPUT("stat", stat_test());
+	TEST_OUTPUT("lseek pread", lseek_pread_test());
+	TEST_OUTPUT("buffer cache", bcache_test());
+	TEST_OUTPUT("frame allocator", frame_test());
+	TEST_OUTPUT("kernel heap", kmalloc_test());
+	TEST_OUTPUT("page directory", page_directory_test());
+	TEST_OUTPUT("memory types", memory_type_test());
+	TEST_OUTPUT("user pages", user_pages_test());
+	TEST_OUTPUT("run queue", run_queue_test());
+	TEST_OUTPUT("wait queue", wait_queue_test());
+	TEST_OUTPUT("mlfq", mlfq_test());
+	TEST_OUTPUT("edf", edf_test());
+	TEST_OUTPUT("exec cache", exec_cache_test());
+	TEST_OUTPUT("overlay write", overlay_write_test());
 
 	
 	// launch your tests here
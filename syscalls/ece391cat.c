@@ -7,6 +7,7 @@ int main ()
 {
     int32_t fd, cnt;
     uint8_t buf[1024];
+    ece391_stat_t st;
 
     if (0 != ece391_getargs (buf, 1024)) {
         ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
@@ -18,6 +19,10 @@ int main ()
 	return 2;
     }
 
+    /* nothing to copy out of an empty file */
+    if (0 == ece391_fstat (fd, &st) && 0 == st.size)
+        return 0;
+
     while (0 != (cnt = ece391_read (fd, buf, 1024))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
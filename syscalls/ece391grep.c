@@ -5,6 +5,150 @@
 
 #define BUFSIZE 1024
 #define SBUFSIZE 33
+#define NUM_DIRENTS 16
+
+/* trigram index written by mkfs -t, its layout is described in mkfs/mkfs.c */
+#define TRI_NAME ".tri"
+#define TRI_MAGIC 0x31495254
+#define TRI_HEADER_SIZE 16
+#define TRI_MAX_FILES 1024
+#define TRI_CHUNK 256
+
+static int32_t tri_fd = -1;
+static uint8_t* tri_map;	/* the mapped index, NULL if it is read with pread */
+static uint32_t tri_len;
+static uint32_t tri_files;	/* entries in the index's file table */
+static uint32_t tri_grams;
+static uint8_t candidate[TRI_MAX_FILES];	/* 1 if the file holds every trigram searched for */
+
+/* copies n bytes at off out of the index; returns 0, or -1 past its end */
+int32_t
+tri_read (uint32_t off, void* buf, uint32_t n)
+{
+    uint32_t i;
+
+    if (off > tri_len || n > tri_len - off)
+        return -1;
+    if (NULL == tri_map)
+        return (n == ece391_pread (tri_fd, buf, n, off)) ? 0 : -1;
+    for (i = 0; i < n; i++)
+        ((uint8_t*)buf)[i] = tri_map[off + i];
+    return 0;
+}
+
+uint32_t
+get32 (const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* binary search of the trigram table; fills the posting range, returns -1 if absent */
+int32_t
+tri_find (uint32_t gram, uint32_t* first, uint32_t* end)
+{
+    uint32_t lo = 0, hi = tri_grams, mid, base;
+    uint8_t ent[16];
+
+    base = TRI_HEADER_SIZE + 8 * tri_files;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+	if (0 != tri_read (base + 8 * mid, ent, 16))
+	    return -1;
+	if (get32 (ent) == gram) {
+	    *first = get32 (ent + 4);
+	    *end = get32 (ent + 12);
+	    return (*first <= *end && *end <= tri_len / 2) ? 0 : -1;
+	}
+	if (get32 (ent) < gram)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return -1;
+}
+
+/* 
+ * Opens the index and marks the files holding every trigram of s; returns 0 if the
+ * index can rule files out, -1 if every file has to be searched
+ */
+int32_t
+tri_load (const uint8_t* s, int32_t s_len)
+{
+    uint8_t head[TRI_HEADER_SIZE], post[2 * TRI_CHUNK];
+    uint8_t hit[TRI_MAX_FILES];
+    uint32_t gram, first, end, n, i, base;
+    int32_t pos, prev;
+    ece391_stat_t st;
+
+    if (s_len < 3 || -1 == (tri_fd = ece391_open ((uint8_t*)TRI_NAME)))
+        return -1;
+    if (0 != ece391_fstat (tri_fd, &st))
+        return -1;
+    tri_len = st.size;
+    /* files on disk or compressed can't be mapped, they are read a piece at a time */
+    if (ece391_mmap (tri_fd, &tri_map) != tri_len)
+        tri_map = NULL;
+    if (0 != tri_read (0, head, TRI_HEADER_SIZE) || TRI_MAGIC != get32 (head))
+        return -1;
+    tri_files = get32 (head + 4);
+    tri_grams = get32 (head + 8);
+    if (tri_files > TRI_MAX_FILES || tri_grams > tri_len / 8)
+        return -1;
+    base = TRI_HEADER_SIZE + 8 * tri_files + 8 * (tri_grams + 1);
+
+    for (i = 0; i < tri_files; i++)
+        candidate[i] = 1;
+    for (pos = 0; pos + 2 < s_len; pos++) {
+        gram = (s[pos] << 16) | (s[pos + 1] << 8) | s[pos + 2];
+	for (prev = 0; prev < pos; prev++) {
+	    if (s[prev] == s[pos] && s[prev + 1] == s[pos + 1] && s[prev + 2] == s[pos + 2])
+	        break;
+	}
+	if (prev < pos)	/* already intersected */
+	    continue;
+	for (i = 0; i < tri_files; i++)
+	    hit[i] = 0;
+	/* a trigram no file holds leaves no candidates */
+	if (0 == tri_find (gram, &first, &end)) {
+	    for (; first < end; first += n) {
+	        n = (end - first < TRI_CHUNK) ? end - first : TRI_CHUNK;
+		if (0 != tri_read (base + 2 * first, post, 2 * n))
+		    return -1;
+		for (i = 0; i < n; i++) {
+		    if (post[2 * i] + (post[2 * i + 1] << 8) < tri_files)
+		        hit[post[2 * i] + (post[2 * i + 1] << 8)] = 1;
+		}
+	    }
+	}
+	for (i = 0; i < tri_files; i++)
+	    candidate[i] &= hit[i];
+    }
+    return 0;
+}
+
+/* 
+ * 1 if the index rules the file out; a file written since the image was built has
+ * a new inode or length, or isn't listed, and is searched
+ */
+int32_t
+tri_skip (uint32_t inode, uint32_t size)
+{
+    uint32_t lo = 0, hi = tri_files, mid;
+    uint8_t ent[8];
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+	if (0 != tri_read (TRI_HEADER_SIZE + 8 * mid, ent, 8))
+	    return 0;
+	if (get32 (ent) == inode)
+	    return (get32 (ent + 4) == size && !candidate[mid]);
+	if (get32 (ent) < inode)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return 0;
+}
 
 int32_t
 do_one_file (const char* s, const char* fname) 
@@ -67,30 +211,44 @@ do_one_file (const char* s, const char* fname)
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, i, len, indexed;
     uint8_t buf[SBUFSIZE];
     uint8_t search[BUFSIZE];
+    ece391_dirent_t dirents[NUM_DIRENTS];
 
     if (0 != ece391_getargs (search, BUFSIZE)) {
         ece391_fdputs (1, (uint8_t*)"could not read argument\n");
         return 3;
     }
 
+    indexed = (0 == tri_load (search, ece391_strlen (search)));
+
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* one call lists up to NUM_DIRENTS entries */
+    while (0 != (cnt = ece391_getdents (fd, dirents, sizeof (dirents)))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	    return 3;
 	}
-	if ('.' == buf[0]) /* a directory... */
-	    continue;
-	buf[cnt] = '\0';
-	if (0 != do_one_file ((char*)search, (char*)buf))
-	    return 3;
+	for (i = 0; i < cnt / sizeof (ece391_dirent_t); i++) {
+	    if (2 != dirents[i].type) /* a directory or device... */
+		continue;
+	    if (0 == dirents[i].size) /* nothing to search */
+		continue;
+	    if (indexed && tri_skip (dirents[i].inode, dirents[i].size))
+		continue;
+	    for (len = 0; len < SBUFSIZE-1 && '\0' != dirents[i].name[len]; len++)
+		buf[len] = dirents[i].name[len];
+	    buf[len] = '\0';
+	    if (0 == ece391_strcmp (buf, (uint8_t*)TRI_NAME))
+		continue;
+	    if (0 != do_one_file ((char*)search, (char*)buf))
+		return 3;
+	}
     }
 
     return 0;